@@ -0,0 +1,363 @@
+// Scheduler and primitive micro-benchmarks.
+//
+// Each benchmark builds a fresh CSimpyEnv, runs a small model to completion and reports the cost
+// per processed event (CSimpyEnv::events_processed): wall time, heap allocations (counted by the
+// replacement operator new below) and the process's peak RSS after the run. Output is JSON so
+// runs can be diffed between releases.
+//
+// Usage: csimpy_bench [scale=1]   (scale multiplies the iteration counts)
+
+#include "../include/csimpy/csimpy_env.h"
+#include "../include/csimpy/resource.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+std::atomic<uint64_t> heap_allocations{0};
+}
+
+void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Result {
+    std::string name;
+    uint64_t events = 0;
+    double ns_per_event = 0;
+    double allocs_per_event = 0;
+    long peak_rss_kb = 0;
+};
+
+long peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;  // kilobytes on Linux
+}
+
+// Times model(env), which builds a model in env (resources live inside it) and runs it.
+Result measure(const std::string& name, const std::function<void(CSimpyEnv&)>& model) {
+    CSimpyEnv env;
+    const uint64_t allocs_before = heap_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    model(env);
+    const auto stop = std::chrono::steady_clock::now();
+    const uint64_t allocs = heap_allocations.load() - allocs_before;
+
+    Result r;
+    r.name = name;
+    r.events = env.events_processed;
+    const double events = static_cast<double>(r.events ? r.events : 1);
+    r.ns_per_event = std::chrono::duration<double, std::nano>(stop - start).count() / events;
+    r.allocs_per_event = static_cast<double>(allocs) / events;
+    r.peak_rss_kb = peak_rss_kb();
+    return r;
+}
+
+void raw_schedule(CSimpyEnv& env, int n) {
+    uint32_t rng = 1;
+    for (int i = 0; i < n; ++i) {
+        rng = rng * 1664525u + 1013904223u;
+        auto ev = env.make_event<SimEvent>(env);
+        ev->sim_time = static_cast<int>((rng >> 8) % 100000);
+        env.schedule(ev);
+    }
+}
+
+void delay_ping_pong(CSimpyEnv& env, int n) {
+    for (int p = 0; p < 2; ++p) {
+        env.schedule(env.create_task([&env, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                co_await SimDelay(env, 1);
+            }
+        }), "pinger");
+    }
+}
+
+void container_contention(CSimpyEnv& env, int n) {
+    Container tank(env, 4, "tank");
+    for (int p = 0; p < 8; ++p) {
+        env.schedule(env.create_task([&env, &tank, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                co_await tank.put(1);
+                co_await SimDelay(env, 1);
+            }
+        }), "producer");
+        env.schedule(env.create_task([&env, &tank, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                co_await tank.get(1);
+                co_await SimDelay(env, 2);
+            }
+        }), "consumer");
+    }
+    env.run();
+}
+
+// Patients queue for a few beds and give up after a patience timeout: about half renege.
+void container_reneging(CSimpyEnv& env, int n) {
+    Container beds(env, 2, "beds");
+    beds.set_level(2);
+    for (int p = 0; p < 8; ++p) {
+        env.schedule(env.create_task([&env, &beds, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                auto bed = beds.get_with_timeout(1, 3);
+                if (co_await bed != 0) {
+                    co_await SimDelay(env, 4);
+                    co_await beds.put(1);
+                } else {
+                    co_await SimDelay(env, 1);
+                }
+            }
+        }), "patient");
+    }
+    env.run();
+}
+
+// Eight users sharing four servers, modelled the old way (a Container level as the free count)
+// and with a Resource, whose release hands the unit over without a put event.
+void container_server(CSimpyEnv& env, int n) {
+    Container servers(env, 4, "servers");
+    servers.set_level(4);
+    for (int p = 0; p < 8; ++p) {
+        env.schedule(env.create_task([&env, &servers, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                co_await servers.get(1);
+                co_await SimDelay(env, 1);
+                co_await servers.put(1);
+            }
+        }), "user");
+    }
+    env.run();
+}
+
+void resource_server(CSimpyEnv& env, int n) {
+    Resource servers(env, 4, "servers");
+    for (int p = 0; p < 8; ++p) {
+        env.schedule(env.create_task([&env, &servers, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                ResourceToken server = co_await servers.request();
+                co_await SimDelay(env, 1);
+            }
+        }), "user");
+    }
+    env.run();
+}
+
+// Inventory tanks restocked when they run low, by a monitor that polls the level every tick (as
+// in example_gas_station) or by one that waits on a level watcher.
+void level_monitor(CSimpyEnv& env, int n, bool watch) {
+    constexpr int tanks = 100;
+    std::vector<std::unique_ptr<Container>> stock;
+    auto consumed = std::make_unique<bool[]>(tanks);
+    for (int t = 0; t < tanks; ++t) {
+        stock.push_back(std::make_unique<Container>(env, 100, "stock"));
+        Container& tank = *stock.back();
+        bool& done = consumed[t];
+        tank.set_level(100);
+        env.schedule(env.create_task([&env, &tank, &done, n]() -> Task {
+            for (int i = 0; i < n; ++i) {
+                co_await tank.get(1);
+                co_await SimDelay(env, 1);
+            }
+            done = true;
+        }), "consumer");
+        env.schedule(env.create_task([&env, &tank, &done, watch]() -> Task {
+            while (!done) {
+                if (watch) {
+                    // Left waiting once the consumer stops; the run then simply ends.
+                    co_await tank.when_level_below(20);
+                } else {
+                    co_await SimDelay(env, 1);
+                    if (tank.level >= 20) continue;
+                }
+                co_await tank.put(80);
+            }
+        }), "monitor");
+    }
+    env.run();
+}
+
+enum class StoreFilter { None, SharedFunction, Predicate };
+
+void store_get(CSimpyEnv& env, int n, StoreFilter filter) {
+    Store store(env, 16, "store");
+    env.schedule(env.create_task([&store, n]() -> Task {
+        for (int i = 0; i < n; ++i) {
+            co_await store.put(std::make_shared<SimpleItem>("item", i));
+        }
+    }), "producer");
+    env.schedule(env.create_task([&store, n, filter]() -> Task {
+        auto is_even = [](const std::shared_ptr<ItemBase>& item) { return item->id % 2 == 0; };
+        auto even = std::make_shared<std::function<bool(const std::shared_ptr<ItemBase>&)>>(is_even);
+        for (int i = 0; i < n; ++i) {
+            if (filter == StoreFilter::Predicate && i % 2 == 0) {
+                co_await store.get(is_even);
+            } else {
+                co_await store.get(filter == StoreFilter::SharedFunction && i % 2 == 0 ? even : nullptr);
+            }
+        }
+    }), "consumer");
+    env.run();
+}
+
+void allof_fan_in(CSimpyEnv& env, int children, int rounds) {
+    env.schedule(env.create_task([&env, children, rounds]() -> Task {
+        for (int r = 0; r < rounds; ++r) {
+            std::vector<std::shared_ptr<SimEvent>> delays;
+            for (int c = 0; c < children; ++c) delays.push_back(std::make_shared<SimDelay>(env, 1 + c % 7));
+            auto allof = std::make_shared<AllOfEvent>(env, std::move(delays));
+            co_await *allof;
+        }
+    }), "fan_in");
+}
+
+void anyof_fan_in(CSimpyEnv& env, int children, int rounds) {
+    env.schedule(env.create_task([&env, children, rounds]() -> Task {
+        for (int r = 0; r < rounds; ++r) {
+            std::vector<std::shared_ptr<SimEvent>> delays;
+            for (int c = 0; c < children; ++c) delays.push_back(std::make_shared<SimDelay>(env, 1 + c % 7));
+            auto anyof = std::make_shared<AnyOfEvent>(env, std::move(delays));
+            co_await *anyof;
+        }
+    }), "fan_in");
+}
+
+void interrupts(CSimpyEnv& env, int n) {
+    auto worker = env.create_task([&env]() -> Task {
+        while (true) {
+            try {
+                SimEvent wait(env);
+                co_await wait;
+            } catch (const InterruptException&) {
+            }
+        }
+    });
+    env.schedule(worker, "worker");
+    env.schedule(env.create_task([&env, worker, n]() -> Task {
+        for (int i = 0; i < n; ++i) {
+            co_await SimDelay(env, 1);
+            worker->interrupt();
+        }
+    }), "controller");
+}
+
+// Preemption: the worker sleeps far ahead and is interrupted every tick, so each interrupt strands
+// the queued copy of its delay (cancelled and compacted away rather than popped later).
+void interrupt_sleeping(CSimpyEnv& env, int n) {
+    auto worker = env.process([&env]() -> Task {
+        for (;;) {
+            try {
+                co_await SimDelay(env, 1000000);
+                co_return;
+            } catch (const InterruptException&) {
+            }
+        }
+    });
+    env.process([&env, worker, n]() -> Task {
+        for (int i = 0; i < n; ++i) {
+            co_await SimDelay(env, 1);
+            worker.interrupt();
+        }
+    });
+}
+
+// A parent starts a child and waits for it; the child finishes at once, so every wake-up is due at
+// the current time and the parent can be resumed straight from the child's final suspend.
+Task join_child(CSimpyEnv& env) {
+    co_await SimDelay(env, 0);
+}
+
+void process_join(CSimpyEnv& env, int n) {
+    env.process([&env, n]() -> Task {
+        for (int i = 0; i < n; ++i) {
+            auto done = env.process(join_child, env).completion();
+            co_await *done;
+        }
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const int scale = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1;
+    std::vector<Result> results;
+
+    results.push_back(measure("raw_schedule", [&](CSimpyEnv& env) {
+        raw_schedule(env, 1000000 * scale);
+        env.run();
+    }));
+    results.push_back(measure("simdelay_ping_pong", [&](CSimpyEnv& env) {
+        delay_ping_pong(env, 250000 * scale);
+        env.run();
+    }));
+    results.push_back(measure("container_contention", [&](CSimpyEnv& env) { container_contention(env, 25000 * scale); }));
+    // Same model with requests that fit served inside put()/get(): fewer events for the same work.
+    results.push_back(measure("container_contention_immediate", [&](CSimpyEnv& env) {
+        env.immediate_requests = true;
+        container_contention(env, 25000 * scale);
+    }));
+    results.push_back(measure("container_reneging", [&](CSimpyEnv& env) { container_reneging(env, 25000 * scale); }));
+    results.push_back(measure("container_server", [&](CSimpyEnv& env) { container_server(env, 25000 * scale); }));
+    results.push_back(measure("resource_server", [&](CSimpyEnv& env) { resource_server(env, 25000 * scale); }));
+    results.push_back(measure("level_monitor_polling", [&](CSimpyEnv& env) { level_monitor(env, 2000 * scale, false); }));
+    results.push_back(measure("level_monitor_watch", [&](CSimpyEnv& env) { level_monitor(env, 2000 * scale, true); }));
+    results.push_back(measure("store_get_unfiltered", [&](CSimpyEnv& env) {
+        store_get(env, 100000 * scale, StoreFilter::None);
+    }));
+    results.push_back(measure("store_get_filtered", [&](CSimpyEnv& env) {
+        store_get(env, 100000 * scale, StoreFilter::SharedFunction);
+    }));
+    results.push_back(measure("store_get_predicate", [&](CSimpyEnv& env) {
+        store_get(env, 100000 * scale, StoreFilter::Predicate);
+    }));
+    for (int children : {2, 10, 100, 1000}) {
+        const int rounds = std::max(1, 200000 * scale / children);
+        results.push_back(measure("allof_fan_in_" + std::to_string(children), [&](CSimpyEnv& env) {
+            allof_fan_in(env, children, rounds);
+            env.run();
+        }));
+        results.push_back(measure("anyof_fan_in_" + std::to_string(children), [&](CSimpyEnv& env) {
+            anyof_fan_in(env, children, rounds);
+            env.run();
+        }));
+    }
+    results.push_back(measure("interrupt", [&](CSimpyEnv& env) {
+        interrupts(env, 200000 * scale);
+        env.run();
+    }));
+    results.push_back(measure("interrupt_sleeping", [&](CSimpyEnv& env) {
+        interrupt_sleeping(env, 200000 * scale);
+        env.run();
+    }));
+    results.push_back(measure("process_join", [&](CSimpyEnv& env) {
+        process_join(env, 200000 * scale);
+        env.run();
+    }));
+
+    std::printf("{\n  \"scale\": %d,\n  \"benchmarks\": [\n", scale);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"name\": \"%s\", \"events\": %llu, \"ns_per_event\": %.2f, "
+                    "\"allocs_per_event\": %.3f, \"peak_rss_kb\": %ld}%s\n",
+                    r.name.c_str(), static_cast<unsigned long long>(r.events), r.ns_per_event,
+                    r.allocs_per_event, r.peak_rss_kb, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+    return 0;
+}
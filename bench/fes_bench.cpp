@@ -0,0 +1,111 @@
+// Future-event-set crossover benchmark.
+//
+// Classic "hold" model: fill a backend with N pending events, then repeatedly pop the
+// minimum and push it back with time = popped time + delay. Reports ns per hold for every
+// backend at N = 10^3 .. 10^max_exp and names the fastest one per size, which is where the
+// crossover points show up.
+//
+// Usage: csimpy_fes_bench [max_exp=7] [holds=1000000]
+
+#include "../include/csimpy/event_queue.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Layout the engine used before inline keys: a heap of shared_ptrs compared through the pointer.
+struct PointerHeap {
+    struct Node { int time; size_t seq; };
+    struct Compare {
+        bool operator()(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) const {
+            if (a->time != b->time) return a->time > b->time;
+            return a->seq > b->seq;
+        }
+    };
+    std::priority_queue<std::shared_ptr<Node>, std::vector<std::shared_ptr<Node>>, Compare> q;
+
+    void push(EventKey key, uint32_t) { q.push(std::make_shared<Node>(Node{key.time, key.seq})); }
+    QueueEntry<uint32_t> pop() {
+        auto n = q.top();
+        q.pop();
+        return {EventKey{n->time, n->seq}, 0};
+    }
+};
+
+struct Workload {
+    const char* name;
+    std::function<int(std::mt19937&)> delay;
+};
+
+template<typename Queue>
+double run_hold(Queue& q, size_t pending, size_t holds, const Workload& w, uint64_t& checksum) {
+    std::mt19937 rng(42);
+    size_t seq = 0;
+    for (size_t i = 0; i < pending; ++i) {
+        q.push(EventKey{w.delay(rng), seq++}, 0u);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < holds; ++i) {
+        auto e = q.pop();
+        checksum += static_cast<uint64_t>(e.key.time);
+        q.push(EventKey{e.key.time + w.delay(rng), seq++}, 0u);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / static_cast<double>(holds);
+}
+
+template<typename Queue>
+double measure(size_t pending, size_t holds, const Workload& w, uint64_t& checksum) {
+    auto q = std::make_unique<Queue>();
+    return run_hold(*q, pending, holds, w, checksum);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const int max_exp = argc > 1 ? std::atoi(argv[1]) : 7;
+    const size_t holds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+    const std::vector<Workload> workloads = {
+        {"small_int", [](std::mt19937& rng) { return static_cast<int>(rng() % 16); }},
+        {"exponential", [](std::mt19937& rng) {
+             std::exponential_distribution<double> d(1.0 / 1000.0);
+             return static_cast<int>(d(rng));
+         }},
+    };
+    const char* names[] = {"shared_ptr_heap", "binary_heap", "quad_heap", "pairing_heap", "calendar_queue", "timing_wheel"};
+    uint64_t checksum = 0;
+
+    std::printf("workload,pending,%s,%s,%s,%s,%s,%s,fastest\n", names[0], names[1], names[2], names[3], names[4], names[5]);
+    for (const auto& w : workloads) {
+        for (int e = 3; e <= max_exp; ++e) {
+            const size_t n = static_cast<size_t>(std::pow(10.0, e));
+            double ns[6] = {
+                measure<PointerHeap>(n, holds, w, checksum),
+                measure<BinaryHeap<uint32_t>>(n, holds, w, checksum),
+                measure<QuadHeap<uint32_t>>(n, holds, w, checksum),
+                measure<PairingHeap<uint32_t>>(n, holds, w, checksum),
+                measure<CalendarQueue<uint32_t>>(n, holds, w, checksum),
+                measure<TimingWheel<uint32_t>>(n, holds, w, checksum),
+            };
+            int best = 0;
+            for (int i = 1; i < 6; ++i) {
+                if (ns[i] < ns[best]) best = i;
+            }
+            std::printf("%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%s\n", w.name, n,
+                        ns[0], ns[1], ns[2], ns[3], ns[4], ns[5], names[best]);
+            std::fflush(stdout);
+        }
+    }
+    std::fprintf(stderr, "checksum %llu\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Macro-benchmarks: the carwash, gas station and patient flow examples scaled up to many entities.
+//
+// The models mirror simpy_examples/scaled_models.py step for step (same resources, same
+// deterministic arrival and service patterns, no output), so bench/macro_compare.py can run both
+// and report the speedup. Each run prints one JSON object.
+//
+// Usage: csimpy_macro_bench <carwash|gas_station|patient_flow> <entities>
+
+#include "../include/csimpy/csimpy_env.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Deterministic stand-ins for random draws, identical in the Python models.
+int inter_arrival(long i) { return 1 + static_cast<int>(i % 3); }          // mean 2
+int spread(long i, int base, int mul) { return base + static_cast<int>(i * mul % 11); }  // base + 0..10
+
+// Carwash: cars queue for one of 6 machines (a Container of tokens) and wash for 5..15.
+void carwash(CSimpyEnv& env, long n) {
+    Container machines(env, 6, "machines", WaiterDiscipline::Fifo);
+    machines.set_level(6);
+    auto car = [&env, &machines](long i) -> Task {
+        co_await machines.get(1);
+        co_await SimDelay(env, spread(i, 5, 7));
+        co_await machines.put(1);
+    };
+    env.schedule(env.create_task([&env, &car, n]() -> Task {
+        for (long i = 0; i < n; ++i) {
+            env.process(car, i);
+            co_await SimDelay(env, inter_arrival(i));
+        }
+    }), "arrivals");
+    env.run();
+}
+
+// Gas station: 8 pumps and a 2000-unit tank; each car takes 5..15 units. A monitor checks the tank
+// every 10 units and, when it is below 500, sends one truck that refills it 30 units later.
+void gas_station(CSimpyEnv& env, long n) {
+    Container pumps(env, 8, "pumps", WaiterDiscipline::Fifo);
+    pumps.set_level(8);
+    Container fuel_tank(env, 2000, "fuel_tank", WaiterDiscipline::Fifo);
+    fuel_tank.set_level(2000);
+    long cars_left = n;
+    bool truck_pending = false;
+
+    auto car = [&env, &pumps, &fuel_tank, &cars_left](long i) -> Task {
+        co_await pumps.get(1);
+        co_await fuel_tank.get(spread(i, 5, 3));
+        co_await SimDelay(env, 3);
+        co_await pumps.put(1);
+        --cars_left;
+    };
+    auto truck = [&env, &fuel_tank, &truck_pending]() -> Task {
+        co_await SimDelay(env, 30);
+        co_await fuel_tank.put(fuel_tank.capacity - fuel_tank.level);
+        truck_pending = false;
+    };
+    env.schedule(env.create_task([&]() -> Task {
+        while (cars_left > 0) {
+            co_await SimDelay(env, 10);
+            if (!truck_pending && fuel_tank.level < 500) {
+                truck_pending = true;
+                env.schedule(env.create_task(truck), "truck");
+            }
+        }
+    }), "monitor");
+    env.schedule(env.create_task([&env, &car, n]() -> Task {
+        for (long i = 0; i < n; ++i) {
+            env.process(car, i);
+            co_await SimDelay(env, inter_arrival(i));
+        }
+    }), "arrivals");
+    env.run();
+}
+
+// Patient flow: registration at one of 2 desks (3 units), then a doctor visit (12 doctors, 15..25)
+// and a lab test (24 labs, 35..45) run as parallel processes; the patient signs out once both finish.
+void patient_flow(CSimpyEnv& env, long n) {
+    Container desks(env, 2, "desks", WaiterDiscipline::Fifo);
+    desks.set_level(2);
+    Container doctors(env, 12, "doctors", WaiterDiscipline::Fifo);
+    doctors.set_level(12);
+    Container labs(env, 24, "labs", WaiterDiscipline::Fifo);
+    labs.set_level(24);
+
+    auto visit = [&env](Container& staff, int duration) -> Task {
+        co_await staff.get(1);
+        co_await SimDelay(env, duration);
+        co_await staff.put(1);
+    };
+    auto patient = [&](long i) -> Task {
+        co_await desks.get(1);
+        co_await SimDelay(env, 3);
+        co_await desks.put(1);
+        auto doctor = env.create_task([&visit, &doctors, i]() { return visit(doctors, spread(i, 15, 7)); });
+        auto lab = env.create_task([&visit, &labs, i]() { return visit(labs, spread(i, 35, 5)); });
+        env.schedule(doctor, "doctor");
+        env.schedule(lab, "lab");
+        auto signout = std::make_shared<AllOfEvent>(env, std::vector<std::shared_ptr<SimEvent>>{
+            doctor->get_completion_event(), lab->get_completion_event()});
+        co_await *signout;
+    };
+    env.schedule(env.create_task([&env, &patient, n]() -> Task {
+        for (long i = 0; i < n; ++i) {
+            env.process(patient, i);
+            co_await SimDelay(env, inter_arrival(i));
+        }
+    }), "arrivals");
+    env.run();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <carwash|gas_station|patient_flow> <entities>\n", argv[0]);
+        return 2;
+    }
+    const std::string model = argv[1];
+    const long n = std::atol(argv[2]);
+
+    CSimpyEnv env;
+    const auto start = std::chrono::steady_clock::now();
+    if (model == "carwash") carwash(env, n);
+    else if (model == "gas_station") gas_station(env, n);
+    else if (model == "patient_flow") patient_flow(env, n);
+    else {
+        std::fprintf(stderr, "unknown model: %s\n", model.c_str());
+        return 2;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("{\"engine\": \"csimpy\", \"model\": \"%s\", \"entities\": %ld, \"events\": %llu, "
+                "\"sim_time\": %d, \"seconds\": %.6f}\n",
+                model.c_str(), n, static_cast<unsigned long long>(env.events_processed), env.sim_time, seconds);
+    return 0;
+}
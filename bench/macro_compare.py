@@ -0,0 +1,47 @@
+"""
+Runs the scaled macro-benchmark models in csimpy and SimPy and reports the speedup.
+
+Usage: python bench/macro_compare.py <path to csimpy_macro_bench> [--sizes 100000 1000000 ...]
+                                     [--models carwash ...] [--simpy-max N]
+
+SimPy is skipped for sizes above --simpy-max (default 10^6), since a 10^7-entity SimPy run takes
+many minutes. Output is a JSON list with one entry per model and size.
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+MODELS = ["carwash", "gas_station", "patient_flow"]
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def run(cmd):
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True, cwd=REPO).stdout
+    return json.loads(out.strip().splitlines()[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("binary")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[10**5, 10**6, 10**7])
+    parser.add_argument("--models", nargs="+", default=MODELS, choices=MODELS)
+    parser.add_argument("--simpy-max", type=int, default=10**6)
+    args = parser.parse_args()
+
+    report = []
+    for model in args.models:
+        for n in args.sizes:
+            entry = {"model": model, "entities": n, "csimpy": run([os.path.abspath(args.binary), model, str(n)])}
+            if n <= args.simpy_max:
+                entry["simpy"] = run([sys.executable, "-m", "simpy_examples.scaled_models", model, str(n)])
+                entry["speedup"] = round(entry["simpy"]["seconds"] / max(entry["csimpy"]["seconds"], 1e-9), 2)
+                entry["same_end_time"] = entry["simpy"]["sim_time"] == entry["csimpy"]["sim_time"]
+            report.append(entry)
+            print(json.dumps(entry), file=sys.stderr)
+    print(json.dumps(report, indent=2))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,183 @@
+//
+// Intrusive callback lists for SimEvent: pooled nodes, O(1) unsubscribe, moved instead of copied.
+//
+
+#ifndef CALLBACK_LIST_H
+#define CALLBACK_LIST_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct CallbackLink {
+    CallbackLink* prev = nullptr;  // nullptr while the node is not in any list
+    CallbackLink* next = nullptr;
+};
+
+class CallbackPool;
+
+// One registered callback. Callables up to inline_size bytes are stored in the node itself.
+struct CallbackNode : CallbackLink {
+    static constexpr size_t inline_size = 32;
+
+    void (*invoke)(CallbackNode*, int) = nullptr;
+    void (*destroy)(CallbackNode*) = nullptr;
+    CallbackPool* pool = nullptr;
+    uint32_t generation = 0;  // bumped on release, so stale handles stop matching
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+
+    bool linked() const { return prev != nullptr; }
+    void unlink() {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = nullptr;
+    }
+};
+
+// Per-environment free list of callback nodes, allocated in chunks and reused.
+class CallbackPool {
+public:
+    CallbackPool() = default;
+    CallbackPool(const CallbackPool&) = delete;
+    CallbackPool& operator=(const CallbackPool&) = delete;
+
+    CallbackNode* acquire() {
+        if (!free_list) grow();
+        CallbackNode* node = free_list;
+        free_list = static_cast<CallbackNode*>(node->next);
+        node->next = nullptr;
+        return node;
+    }
+
+    // Destroys the node's callable and puts it back on the free list.
+    void release(CallbackNode* node) {
+        node->destroy(node);
+        node->invoke = nullptr;
+        ++node->generation;
+        node->next = free_list;
+        free_list = node;
+    }
+
+private:
+    static constexpr size_t chunk_size = 256;
+
+    void grow() {
+        chunks.push_back(std::make_unique<CallbackNode[]>(chunk_size));
+        CallbackNode* chunk = chunks.back().get();
+        for (size_t i = 0; i < chunk_size; ++i) {
+            chunk[i].pool = this;
+            chunk[i].next = i + 1 < chunk_size ? &chunk[i + 1] : free_list;
+        }
+        free_list = chunk;
+    }
+
+    std::vector<std::unique_ptr<CallbackNode[]>> chunks;
+    CallbackNode* free_list = nullptr;
+};
+
+// Returned by CallbackList::add. cancel() unlinks the callback in O(1) if it has not fired yet,
+// wherever its list has been moved since; afterwards (or after it fired) it does nothing.
+class CallbackHandle {
+public:
+    CallbackHandle() = default;
+    CallbackHandle(CallbackNode* n, uint32_t gen) : node(n), generation(gen) {}
+
+    bool pending() const { return node && node->generation == generation && node->linked(); }
+
+    void cancel() {
+        if (!pending()) return;
+        node->unlink();
+        node->pool->release(node);
+        node = nullptr;
+    }
+
+private:
+    CallbackNode* node = nullptr;
+    uint32_t generation = 0;
+};
+
+// Circular doubly linked list of callbacks with an embedded sentinel. Moving a list relinks its
+// two ends, so handing callbacks to another event never copies them.
+class CallbackList {
+public:
+    explicit CallbackList(CallbackPool& p) : pool(&p) { reset(); }
+    CallbackList(const CallbackList&) = delete;
+    CallbackList& operator=(const CallbackList&) = delete;
+
+    CallbackList(CallbackList&& other) noexcept : pool(other.pool) { take(other); }
+    CallbackList& operator=(CallbackList&& other) noexcept {
+        if (this != &other) {
+            clear();
+            take(other);
+        }
+        return *this;
+    }
+
+    ~CallbackList() { clear(); }
+
+    template<typename F>
+    CallbackHandle add(F&& f) {
+        using Fn = std::decay_t<F>;
+        CallbackNode* node = pool->acquire();
+        if constexpr (sizeof(Fn) <= CallbackNode::inline_size && alignof(Fn) <= alignof(std::max_align_t)) {
+            new (node->storage) Fn(std::forward<F>(f));
+            node->invoke = [](CallbackNode* n, int time) { (*std::launder(reinterpret_cast<Fn*>(n->storage)))(time); };
+            node->destroy = [](CallbackNode* n) { std::launder(reinterpret_cast<Fn*>(n->storage))->~Fn(); };
+        } else {
+            *reinterpret_cast<Fn**>(node->storage) = new Fn(std::forward<F>(f));
+            node->invoke = [](CallbackNode* n, int time) { (**reinterpret_cast<Fn**>(n->storage))(time); };
+            node->destroy = [](CallbackNode* n) { delete *reinterpret_cast<Fn**>(n->storage); };
+        }
+        node->prev = head.prev;
+        node->next = &head;
+        head.prev->next = node;
+        head.prev = node;
+        return CallbackHandle(node, node->generation);
+    }
+
+    bool empty() const { return head.next == &head; }
+
+    // Calls every callback once, in registration order, and empties the list. Callbacks may
+    // cancel ones that have not run yet; callbacks added meanwhile stay for the next fire().
+    void fire(int time) {
+        if (empty()) return;
+        CallbackList pending(std::move(*this));
+        while (!pending.empty()) {
+            auto* node = static_cast<CallbackNode*>(pending.head.next);
+            node->unlink();
+            node->invoke(node, time);
+            pool->release(node);
+        }
+    }
+
+    void clear() {
+        while (!empty()) {
+            auto* node = static_cast<CallbackNode*>(head.next);
+            node->unlink();
+            pool->release(node);
+        }
+    }
+
+private:
+    CallbackPool* pool;
+    CallbackLink head;
+
+    void reset() { head.prev = head.next = &head; }
+
+    void take(CallbackList& other) {
+        if (other.empty()) {
+            reset();
+            return;
+        }
+        head.next = other.head.next;
+        head.prev = other.head.prev;
+        head.next->prev = &head;
+        head.prev->next = &head;
+        other.reset();
+    }
+};
+
+#endif //CALLBACK_LIST_H
@@ -5,28 +5,52 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
-#include <atomic>
 #include <algorithm>
 #include <cassert>
+#include <list>
+#include <map>
+#include <set>
 #include <memory>
 #include <type_traits>
+#include <optional>
+#include <limits>
+#include <random>
+#include <span>
 #include "itembase.h"
+#include "event_pool.h"
+#include "event_queue.h"
+#include "inline_vector.h"
+#include "callback_list.h"
+#include "frame_pool.h"
+#include "trace.h"
 
-// Priority enum for store events
-enum class Priority { Low = 0, High = 1 };
+// Priority for store events. Any int is a valid level (e.g. Priority{5} for a triage level);
+// higher levels are served first and equal levels in arrival order.
+enum class Priority : int { Low = 0, High = 1 };
 
 
 struct AllOfEvent;
-struct CompareSimEvent;
 struct CoroutineProcess;
 class SimEvent;
 class Task;
+class CSimpyEnv;
 // Forward declarations for container event types
 struct ContainerPutEvent;
 struct ContainerGetEvent;
 constexpr bool DEBUG_PRINT_QUEUE = false;
 constexpr bool DEBUG_RESOURCE = false;
-constexpr bool DEBUG_MEMORY = false;
+
+// Stand-in for event/await labels when DEBUG_PRINT_QUEUE is off: it swallows whatever it is
+// built or concatenated from, so labelling a wait costs nothing in release builds.
+struct NoLabel {
+    NoLabel() = default;
+    template<typename T>
+    NoLabel(const T&) {}
+    friend NoLabel operator+(const char*, const NoLabel&) { return {}; }
+    friend std::ostream& operator<<(std::ostream& os, const NoLabel&) { return os; }
+};
+// Labels only exist for queue dumps.
+using DebugLabel = std::conditional_t<DEBUG_PRINT_QUEUE, std::string, NoLabel>;
 
 
 
@@ -34,62 +58,264 @@ struct SimEventBase {
     int sim_time;
     std::shared_ptr<ItemBase> value;
     bool done = false;
-    size_t unique_id;
-    static inline std::atomic<size_t> uid_gen{0};
-    static inline std::atomic<size_t> alloc_counter{0};
-    static inline std::unordered_map<void*, size_t> alloc_map;
-    SimEventBase() : unique_id(++uid_gen) {}
+    size_t unique_id;  // tie-breaker within a timestamp, drawn from the owning env's counter
+
+    // Intrusive reference count used by EventPtr; set up by CSimpyEnv::make_event for pooled events.
+    uint32_t ref_count = 0;
+    uint8_t pool_class = EventPool::unpooled;
+    uint8_t queued = 0;      // entries for this event currently in its env's queue
+    bool cancelled = false;  // tombstone: dropped unprocessed when it reaches the front
+    EventPool* pool = nullptr;
+
+    explicit SimEventBase(size_t id) : unique_id(id) {}
+    // Copies carry the event state but never the ownership bookkeeping.
+    SimEventBase(const SimEventBase& other)
+        : sim_time(other.sim_time), value(other.value), done(other.done), unique_id(other.unique_id) {}
+    SimEventBase& operator=(const SimEventBase&) = delete;
     virtual void resume() = 0;
     virtual ~SimEventBase() = default;
-};
+    // A process wake-up returns the coroutine resume() would run, with the env prepared as
+    // resume() does it, so a suspending coroutine can transfer to it directly. Other events
+    // return nullptr.
+    virtual std::coroutine_handle<> resume_target() { return nullptr; }
 
+    void add_ref() noexcept {
+        if (ref_count++ == 0) on_first_ref();
+    }
+    void release_ref() noexcept {
+        if (--ref_count == 0) on_last_ref();
+    }
+
+    // Events that are owned elsewhere (e.g. by a std::shared_ptr) override these to stay
+    // alive while the queue references them. Pooled events go back to their pool.
+    virtual void on_first_ref() {}
+    virtual void on_last_ref() {
+        if (pool) recycle();
+    }
 
-struct CompareSimEvent {
-    bool operator()(const std::shared_ptr<SimEventBase>& a, const std::shared_ptr<SimEventBase>& b) const {
-        if (a->sim_time != b->sim_time)
-            return a->sim_time > b->sim_time;
-        return a->unique_id > b->unique_id;
+protected:
+    void recycle() noexcept {
+        EventPool* owner = pool;
+        const uint8_t cls = pool_class;
+        void* block = dynamic_cast<void*>(this);
+        this->~SimEventBase();
+        owner->deallocate(block, cls);
     }
 };
+
+
+// Generation-checked reference to a process (a task created through CSimpyEnv::create_task).
+// The env recycles a process's slot once it finishes; a handle to the old occupant then simply
+// stops resolving, so it is always safe to hold on to one.
+struct ProcessHandle {
+    CSimpyEnv* env = nullptr;
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+
+    Task* get() const;  // nullptr once the process finished and was reclaimed
+    bool alive() const { return get() != nullptr; }
+    explicit operator bool() const { return alive(); }
+
+    // Interrupts the process if it is still alive.
+    void interrupt(std::shared_ptr<ItemBase> cause = nullptr) const;
+    // Event that succeeds when the process finishes; already done if it has finished.
+    std::shared_ptr<SimEvent> completion() const;
+};
+
+
 class CSimpyEnv {
 public:
     int sim_time = 0;
-
-    std::priority_queue<
-        std::shared_ptr<SimEventBase>,
-        std::vector<std::shared_ptr<SimEventBase>>,
-        CompareSimEvent
-    > event_queue;
-    std::vector<std::shared_ptr<Task>> active_tasks;
-    std::vector<std::shared_ptr<void>> active_functors;
-    // Track scheduled events by unique_id
-    std::unordered_map<size_t, std::weak_ptr<SimEventBase>> scheduled_events;
-    void schedule(std::shared_ptr<SimEventBase>);
-    void schedule(std::shared_ptr<Task> t, const std::string& label) ;
+    uint64_t events_processed = 0;  // events popped and resumed by the run loops
+    // Opt-in: a Container/Store/TypedStore request that can be served on the spot, with nobody
+    // waiting ahead of it, completes inside put()/get() and co_await continues without suspending
+    // or queueing anything. Off by default, because the requester then runs on before the other
+    // events due at the same time, where SimPy would let them go first.
+    bool immediate_requests = false;
+
+    // Cancellation: cancel() leaves a tombstone that is dropped, unprocessed and uncounted by
+    // events_processed, when it reaches the front of the queue. Once tombstones make up more than
+    // compact_fraction of the queue, it is compacted in one pass.
+    uint64_t events_cancelled = 0;  // queued events cancelled
+    uint64_t events_skipped = 0;    // tombstones dropped, at the front or by compaction
+    uint64_t queue_compactions = 0;
+    double compact_fraction = 0.5;
+
+    // Coroutine frames of this env's tasks; declared first so it outlives the process table.
+    FramePool frame_pool;
+    // Outlives every event's callback list.
+    CallbackPool callback_pool;
+    // Declared early so it outlives the queue and the tasks that still hold pooled events.
+    EventPool event_pool;
+
+    // Future event set, ordered by (sim_time, unique_id). The backend only changes cost, never order.
+    std::unique_ptr<FutureEventSet<EventPtr<SimEventBase>>> event_queue;
+    // Fast lane for events due at the current sim_time. It only accepts entries whose unique_id
+    // is above its tail, so it stays sorted and run() merges it with event_queue in exact order.
+    FifoRing<QueueEntry<EventPtr<SimEventBase>>> now_queue;
+
+    // Per-environment random stream, so replications running side by side never share state.
+    std::mt19937_64 rng;
+
+    explicit CSimpyEnv(QueueKind kind = QueueKind::QuadHeap, uint64_t seed = 0)
+        : event_queue(make_future_event_set<EventPtr<SimEventBase>>(kind)), rng(seed) {}
+    CSimpyEnv(const CSimpyEnv&) = delete;
+    CSimpyEnv& operator=(const CSimpyEnv&) = delete;
+
+    // Sequence numbers for event tie-breaking; events created in one env never touch another's.
+    size_t next_event_id() { return ++event_id_gen; }
+    // Process table: the env's own reference to each live task and the functor its frame
+    // points into. Slots are released after the task finishes and reused with a new generation.
+    struct ProcessSlot {
+        std::shared_ptr<Task> task;
+        std::shared_ptr<void> functor;
+        uint32_t generation = 0;
+        uint32_t trace_id = 0;  // unique per process, unlike the slot
+    };
+    std::vector<ProcessSlot> processes;
+    void schedule(EventPtr<SimEventBase> ev);
+    void schedule(std::shared_ptr<Task> t, const DebugLabel& label) ;
+    // Queues a pooled wake-up that resumes the process at the given time (if it still exists).
+    void schedule_resume(int time, ProcessHandle proc, DebugLabel label = {});
     template<typename F>
     std::shared_ptr<Task> create_task(F&& coroutine_func);
+    // Starts fn(args...) as a process at the current time. The coroutine is built in place: a
+    // function, a captureless lambda or a callable passed by lvalue (which must outlive the
+    // process) is called directly, and only a stateful temporary is kept alive by the env.
+    // Arguments are copied into the frame if the coroutine takes them by value.
+    template<typename F, typename... Args>
+    ProcessHandle process(F&& fn, Args&&... args);
+    // Constructs an event in this environment's pool.
+    template<typename T, typename... Args>
+    EventPtr<T> make_event(Args&&... args);
+    // Cancels an event waiting in the queue; its resume() is never called. Does nothing if the
+    // event is not queued. A cancelled event stays cancelled.
+    void cancel(SimEventBase& ev);
+    size_t tombstones() const { return tombstone_count; }
     void print_event_queue_state();
+
+    // Processes events until the queue is empty (or the stop condition fires).
     void run();
+    // Processes every event due before `until`, then moves the clock to `until`. Events at
+    // exactly `until` stay queued, matching SimPy's env.run(until=...).
+    void run_until(int until);
+    // Processes at most n events; returns how many were processed.
+    size_t run_for(size_t n_events);
+    // Processes exactly one event, ignoring the stop condition. Returns false if none is pending.
+    bool step();
+    // Time of the next pending event, or nullopt if the queue is empty.
+    std::optional<int> peek_next_time() const;
+    // Predicate checked by run/run_until/run_for whenever the clock is about to advance; when it
+    // returns true the run stops before the next timestamp is processed. Pass {} to clear.
+    void stop_when(std::function<bool()> predicate) { stop_condition = std::move(predicate); }
+
+    // Called by every awaiter once its coroutine is suspended. Handles what the run loop would
+    // handle next, as long as it is due at the current time: plain events are resumed in place,
+    // and a process wake-up is returned so the awaiter transfers to that coroutine directly.
+    // Otherwise returns noop_coroutine() and control goes back to the run loop. Order and
+    // events_processed are exactly those of the run loop, which lends its remaining event budget
+    // (step() lends none). `finishing` is set by a task's final suspend, whose frame must not be
+    // destroyed while it is still in await_suspend.
+    std::coroutine_handle<> handoff(bool finishing = false) {
+        // Nothing due now: the run loop advances the clock next, so there is nothing to gain.
+        if (handoff_budget == 0 || !due_now()) return std::noop_coroutine();
+        return drain_now(finishing);
+    }
+
+    Task* lookup(ProcessHandle proc) const {
+        if (proc.env != this || proc.slot >= processes.size()) return nullptr;
+        const ProcessSlot& entry = processes[proc.slot];
+        return entry.generation == proc.generation ? entry.task.get() : nullptr;
+    }
+    // Called from a task's final suspend; the slot is reclaimed once control is back in run().
+    void mark_finished(ProcessHandle proc) { finished_processes.push_back(proc.slot); }
+    size_t live_processes() const { return processes.size() - free_process_slots.size(); }
+
+    // Binary event trace (trace.h), off by default. Enabling starts a writer thread; disabling
+    // flushes and closes the file.
+    void enable_trace(const std::string& path, size_t ring_records = size_t{1} << 16) {
+        tracer = std::make_unique<TraceWriter>(path, ring_records);
+    }
+    void disable_trace() { tracer.reset(); }
+    uint64_t trace_records() const { return tracer ? tracer->records() : 0; }
+    // Every trace point goes through here, so with tracing off it is a single branch.
+    void trace(TraceKind kind, int time, uint64_t seq, uint32_t process, uint32_t resource = 0) {
+        if (tracer) [[unlikely]] tracer->record(kind, time, seq, process, resource);
+    }
+    uint32_t trace_id_of(ProcessHandle proc) const {
+        return lookup(proc) ? processes[proc.slot].trace_id : 0;
+    }
+    uint32_t next_resource_id() { return ++resource_id_gen; }
+    // Trace id of the process currently running, 0 between processes.
+    uint32_t current_process = 0;
+
+private:
+    std::function<bool()> stop_condition;
+    size_t event_id_gen = 0;
+    std::vector<uint32_t> free_process_slots;
+    std::vector<uint32_t> finished_processes;
+    std::vector<ProcessSlot> parked_processes;  // reaped, frames kept until the next reap
+    size_t tombstone_count = 0;                 // cancelled entries still in the queue
+    size_t handoff_budget = 0;                  // events handoff() may still process
+    uint32_t process_id_gen = 0;
+    uint32_t resource_id_gen = 0;
+    std::unique_ptr<TraceWriter> tracer;
+
+    ProcessHandle add_process(std::shared_ptr<Task> task, std::shared_ptr<void> functor);
+    void reap_finished(bool keep_frames = false);
+
+    bool has_pending() const { return !now_queue.empty() || !event_queue->empty(); }
+    // The now lane only ever holds events at the current time.
+    bool due_now() const {
+        return !now_queue.empty() || (!event_queue->empty() && event_queue->top().key.time == sim_time);
+    }
+    std::coroutine_handle<> drain_now(bool finishing);
+    // Pops tombstones off the front, so the next entry (next_key(), peeks) is always live.
+    void discard_cancelled();
+    void compact_queue();
+    void enqueue(EventKey key, EventPtr<SimEventBase> ev);
+    const EventKey& next_key() const;
+    QueueEntry<EventPtr<SimEventBase>> pop_next();
+    size_t run_loop(std::optional<int> horizon, size_t max_events, bool check_stop);
 };
 
+template<typename T, typename... Args>
+EventPtr<T> CSimpyEnv::make_event(Args&&... args) {
+    static_assert(std::is_base_of_v<SimEventBase, T>, "make_event requires a SimEventBase");
+    uint8_t size_class = EventPool::unpooled;
+    void* block = event_pool.allocate(sizeof(T), size_class);
+    T* ev;
+    try {
+        ev = ::new (block) T(std::forward<Args>(args)...);
+    } catch (...) {
+        event_pool.deallocate(block, size_class);
+        throw;
+    }
+    ev->pool = &event_pool;
+    ev->pool_class = size_class;
+    return EventPtr<T>(ev);
+}
+
 
 
-// Concrete event for coroutine handles
-struct CoroutineProcess : SimEventBase {
-    std::coroutine_handle<> handle;
-    std::string label;
+// Wake-up event for a suspended process: just its handle (plus a label in debug builds).
+// Always created through the env's pool, so resuming a coroutine never touches malloc.
+struct CoroutineProcess final : SimEventBase {
+    ProcessHandle process;
+    [[no_unique_address]] DebugLabel label;
 
-    CoroutineProcess(int t, std::coroutine_handle<> h, std::string lbl)
-        : handle(h), label(std::move(lbl)) {
+    CoroutineProcess(CSimpyEnv& env, int t, ProcessHandle p, DebugLabel lbl = {})
+        : SimEventBase(env.next_event_id()), process(p), label(std::move(lbl)) {
         sim_time = t;
     }
-    void resume() override {
-        if (handle && !handle.done()) {   // ✅ only resume if still alive
-            handle.resume();
-        }
-    }
+    void resume() override;
+    std::coroutine_handle<> resume_target() override;
 };
 
+inline void CSimpyEnv::schedule_resume(int time, ProcessHandle proc, DebugLabel label) {
+    schedule(make_event<CoroutineProcess>(*this, time, proc, std::move(label)));
+}
+
 // InterruptException definition
 struct InterruptException : public std::exception {
     std::shared_ptr<ItemBase> cause;
@@ -99,21 +325,30 @@ struct InterruptException : public std::exception {
     }
 };
 
+// Lets condition events tell delays apart from other children without dynamic_cast.
+enum class EventKind : uint8_t { Plain, Delay };
+
 struct SimEvent : SimEventBase {
 
     CSimpyEnv& env;
-    std::vector<std::function<void(int)>> callbacks;
-
-    // Optional filter for Store get events
-    std::function<bool(const std::shared_ptr<ItemBase>&)> item_filter;
+    CallbackList callbacks;
+    EventKind kind = EventKind::Plain;
+    // Resource request served inside the call that made it (CSimpyEnv::immediate_requests). It is
+    // never scheduled, so callbacks added to it do not fire; awaiting it does not suspend.
+    bool immediate = false;
+    // The copy on_succeed scheduled, which now holds the callbacks registered before it, until
+    // that copy fires; copy_of is the back link from the copy.
+    EventPtr<SimEvent> scheduled_copy;
+    SimEvent* copy_of = nullptr;
 
     // Interrupt-related members
     bool interrupted = false;
     std::shared_ptr<ItemBase> interrupt_cause;
 
-    std::string debug_label;
+    [[no_unique_address]] DebugLabel debug_label;
 
-    SimEvent(CSimpyEnv& env_, std::string lbl = "") : env(env_), debug_label(std::move(lbl)) {
+    SimEvent(CSimpyEnv& env_, DebugLabel lbl = {})
+        : SimEventBase(env_.next_event_id()), env(env_), callbacks(env_.callback_pool), debug_label(std::move(lbl)) {
         sim_time = env.sim_time;
     }
 
@@ -124,7 +359,7 @@ struct SimEvent : SimEventBase {
         return true;
     }
 
-    void await_suspend(std::coroutine_handle<> h, const std::string& label = "?");
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h, const DebugLabel& label = "?");
 
     auto await_resume() const {
         if (interrupted) {
@@ -140,11 +375,39 @@ struct SimEvent : SimEventBase {
         value = std::move(val);
     }
 
+    ~SimEvent() override {
+        if (scheduled_copy) scheduled_copy->copy_of = nullptr;
+    }
+
     void trigger() {
-        for (auto& cb : callbacks) {
-            cb(env.sim_time);
+        if (copy_of) {
+            // Fired: the original no longer needs to reach these callbacks.
+            std::exchange(copy_of, nullptr)->scheduled_copy.reset();
         }
-        callbacks.clear();
+        callbacks.fire(env.sim_time);
+    }
+
+    // Fires every pending callback now, including those already handed to the scheduled copy;
+    // the copy would wake nobody, so it is cancelled.
+    void fire_now() {
+        if (scheduled_copy) {
+            scheduled_copy->callbacks.fire(env.sim_time);
+            cancel_scheduled_copy();
+        }
+        callbacks.fire(env.sim_time);
+    }
+
+    // Withdraws the event: whatever is queued for it (the copy on_succeed scheduled, or the event
+    // itself) is dropped unprocessed, so its callbacks never fire and its waiters are not woken.
+    virtual void cancel() {
+        cancel_scheduled_copy();
+        env.cancel(*this);
+    }
+
+    // Cancels the scheduled copy once nothing is subscribed to it any more, e.g. after a
+    // condition event withdrew from this child.
+    void cancel_if_unobserved() {
+        if (scheduled_copy && scheduled_copy->callbacks.empty()) cancel_scheduled_copy();
     }
 
     void resume() override {
@@ -159,21 +422,30 @@ struct SimEvent : SimEventBase {
         on_succeed();
     }
 
-    virtual std::shared_ptr<SimEvent> clone_for_schedule() const {
-        auto clone = std::make_shared<SimEvent>(env);
+    virtual EventPtr<SimEvent> clone_for_schedule() const {
+        auto clone = env.make_event<SimEvent>(env);
         clone->value = value;
         clone->done = done;
         clone->interrupted = interrupted;
         clone->interrupt_cause = interrupt_cause;
-        env.scheduled_events[clone->unique_id] = clone;
         return clone;
     }
 
-    // Schedules a heap-allocated copy of this event at the given time and clears callbacks.
+    void cancel_scheduled_copy() {
+        if (!scheduled_copy) return;
+        EventPtr<SimEvent> copy = std::move(scheduled_copy);
+        copy->copy_of = nullptr;
+        env.cancel(*copy);
+    }
+
+    // Schedules a pooled copy of this event at the given time and hands it the callbacks.
     virtual void on_succeed() {
         done = true;
         auto heap_event = this->clone_for_schedule();
-        heap_event->callbacks = callbacks;
+        heap_event->callbacks = std::move(callbacks);
+        if (scheduled_copy) scheduled_copy->copy_of = nullptr;
+        heap_event->copy_of = this;
+        scheduled_copy = heap_event;
         //heap_event->sim_time = this->sim_time;
         env.schedule(heap_event);
     }
@@ -185,9 +457,14 @@ struct SimEvent : SimEventBase {
 struct TaskPromise {
     std::shared_ptr<SimEvent> completion_event;
     SimEvent* current_event = nullptr;
+    ProcessHandle self;  // this task's slot in its env's process table
 
     Task get_return_object();
 
+    // Frames come from the current thread's FramePool (the env's, inside create_task).
+    static void* operator new(std::size_t size) { return FramePool::allocate_frame(size); }
+    static void operator delete(void* frame) noexcept { FramePool::deallocate_frame(frame); }
+
     void set_completion_event(std::shared_ptr<SimEvent> ce) {
         completion_event = std::move(ce);
     }
@@ -199,13 +476,20 @@ struct TaskPromise {
             TaskPromise* promise;
 
             bool await_ready() noexcept { return false; }
-            void await_suspend(std::coroutine_handle<>) const noexcept {
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept {
                 if (promise->completion_event) {
                     // Signal completion with a FinishItem
                     auto finish_item = std::make_shared<FinishItem>();
                     promise->completion_event->set_value(finish_item);
                     promise->completion_event->on_succeed();
                 }
+                if (CSimpyEnv* env = promise->self.env) {
+                    env->trace(TraceKind::TaskDone, env->sim_time, 0, env->trace_id_of(promise->self));
+                    env->mark_finished(promise->self);
+                    // Waiters woken by the completion event usually run next: go straight to them.
+                    return env->handoff(true);
+                }
+                return std::noop_coroutine();
             }
 
             void await_resume() noexcept {}
@@ -246,20 +530,33 @@ struct Task {
     Task(const Task&) = delete;
     Task& operator=(const Task&) = delete;
 
+    // Created on first request for processes started with env.process().
     std::shared_ptr<SimEvent> get_completion_event() {
-        return h.promise().completion_event;
+        auto& ce = h.promise().completion_event;
+        if (!ce && h.promise().self.env) {
+            ce = std::make_shared<SimEvent>(*h.promise().self.env);
+            ce->done = h.done();
+        }
+        return ce;
     }
 
     CSimpyEnv& get_env() {
-        return h.promise().completion_event->env;
+        return *h.promise().self.env;
     }
 
     bool done() const {
         return h.done();
     }
 
+    ProcessHandle process() const {
+        return h.promise().self;
+    }
+
     void interrupt(std::shared_ptr<ItemBase> cause = nullptr) {
         auto& prom = h.promise();
+        if (CSimpyEnv* env = prom.self.env) {
+            env->trace(TraceKind::Interrupt, env->sim_time, 0, env->trace_id_of(prom.self));
+        }
         if (prom.current_event) {
             prom.current_event->interrupt(cause);
         }
@@ -270,40 +567,79 @@ struct Task {
 
 
 
+// The process a Task coroutine belongs to; read while the coroutine is suspending, so the handle
+// captured by a resume callback stays valid even if the process is gone when the callback fires.
+inline ProcessHandle process_of(std::coroutine_handle<> h) {
+    return std::coroutine_handle<TaskPromise>::from_address(h.address()).promise().self;
+}
+
+inline Task* ProcessHandle::get() const {
+    return env ? env->lookup(*this) : nullptr;
+}
+
+inline void ProcessHandle::interrupt(std::shared_ptr<ItemBase> cause) const {
+    if (Task* task = get()) task->interrupt(std::move(cause));
+}
+
+inline std::shared_ptr<SimEvent> ProcessHandle::completion() const {
+    if (Task* task = get()) return task->get_completion_event();
+    assert(env);
+    auto finished = std::make_shared<SimEvent>(*env);
+    finished->done = true;
+    return finished;
+}
+
+inline std::coroutine_handle<> CoroutineProcess::resume_target() {
+    Task* task = process.get();
+    if (!task || task->h.done()) return nullptr;   // ✅ only resume if still alive
+    CSimpyEnv& env = *process.env;
+    env.current_process = env.processes[process.slot].trace_id;
+    env.trace(TraceKind::Resume, env.sim_time, unique_id, env.current_process);
+    return task->h;
+}
+
+inline void CoroutineProcess::resume() {
+    if (std::coroutine_handle<> h = resume_target()) {
+        CSimpyEnv& env = *process.env;
+        h.resume();  // may run a chain of handoffs; the frame may be gone when it returns
+        env.current_process = 0;
+    }
+}
+
 struct LabeledAwait {
     SimEvent& event;
-    std::string label;
+    DebugLabel label;
 
     bool await_ready() noexcept { return false; }
-    void await_suspend(std::coroutine_handle<> h) { event.await_suspend(h, label); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) { return event.await_suspend(h, label); }
     auto await_resume() { return event.await_resume(); }
 };
 
 struct SimDelay : SimEvent {
     int delay;
 
-    SimDelay(CSimpyEnv& e, int d, std::string lbl = "")
+    SimDelay(CSimpyEnv& e, int d, DebugLabel lbl = {})
         : SimEvent(e, std::move(lbl)) {
+        kind = EventKind::Delay;
         delay = d;
         sim_time = env.sim_time + delay;
     }
 
-    std::shared_ptr<SimEvent> clone_for_schedule() const override {
-        auto clone = std::make_shared<SimDelay>(env, this->delay, this->debug_label);
+    EventPtr<SimEvent> clone_for_schedule() const override {
+        auto clone = env.make_event<SimDelay>(env, this->delay, this->debug_label);
         clone->done = done;
-        env.scheduled_events[clone->unique_id] = clone;
         return clone;
     }
 
-    void await_suspend(std::coroutine_handle<> h,
-                       const std::string& label = "?") {
-        callbacks.emplace_back([this, h, label](int when) {
-            env.schedule(std::make_shared<CoroutineProcess>(
-                when, h, "SimDelay::resume handler -> " + label));
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h,
+                                          const DebugLabel& label = "?") {
+        callbacks.add([this, proc = process_of(h), label](int when) {
+            env.schedule_resume(when, proc, "SimDelay::resume handler -> " + label);
         });
         auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
         ht.promise().current_event = this;
         this->on_succeed();
+        return env.handoff();
     }
 
     void resume() override {
@@ -317,85 +653,90 @@ struct SimDelay : SimEvent {
         delay = 0;
         interrupt_cause = cause;
         sim_time = env.sim_time;  // override scheduled delay, fire now
-        trigger();
+        fire_now();
     }
 };
+// Child events and results of a condition event; a few children are stored inline.
+using ConditionChildren = InlineVector<std::shared_ptr<SimEvent>, 8>;
+using ConditionResults = InlineVector<std::shared_ptr<ItemBase>, 8>;
+
 // Waits for all of a set of SimEvents to complete, then triggers itself.
+// co_await yields a span of the children's values, indexed by child position.
 struct AllOfEvent : SimEvent, std::enable_shared_from_this<AllOfEvent> {
     using SimEvent::SimEvent;  // inherit constructor
-    std::vector<std::shared_ptr<SimEvent>> events;
-    std::vector<std::pair<std::coroutine_handle<>, std::string>> waiters;
+    ConditionChildren events;
+    ConditionResults results;
+    InlineVector<CallbackHandle, 8> subscriptions;  // our callbacks on the children
+    std::vector<std::pair<ProcessHandle, DebugLabel>> waiters;
     int completed = 0;
     CSimpyEnv& env;
 
-    AllOfEvent(CSimpyEnv& env_, std::vector<std::shared_ptr<SimEvent>> evts, std::string lbl = "")
-        : SimEvent(env_, std::move(lbl)), events(std::move(evts)), env(env_) {
+    AllOfEvent(CSimpyEnv& env_, std::vector<std::shared_ptr<SimEvent>> evts, DebugLabel lbl = {})
+        : SimEvent(env_, std::move(lbl)), env(env_) {
+        events.reserve(evts.size());
+        for (auto& e : evts) events.push_back(std::move(e));
+    }
+    AllOfEvent(CSimpyEnv& env_, std::initializer_list<std::shared_ptr<SimEvent>> evts, DebugLabel lbl = {})
+        : SimEvent(env_, std::move(lbl)), events(evts), env(env_) {}
+
+    ~AllOfEvent() override { unsubscribe(); }
+
+    void unsubscribe() {
+        for (auto& sub : subscriptions) sub.cancel();
+        subscriptions.clear();
     }
 
+    // While queued, the event pins itself so the queue never outlives the last shared owner.
+    std::shared_ptr<AllOfEvent> pinned;
+    void on_first_ref() override { pinned = shared_from_this(); }
+    void on_last_ref() override { auto release = std::move(pinned); }
+
     void count(int time) {
         assert(completed < static_cast<int>(events.size()));
         ++completed;
         if (completed == static_cast<int>(events.size())) {
-            // Schedule this AllOfEvent itself (heap-allocated)
-            auto self = shared_from_this();
-
-            // Ensure this->value is always a valid FinishItem with populated map_value
-            if (!this->value) {
-                this->value = std::make_shared<MapItem>("allof", 101);
-            }
-            auto map_item = std::dynamic_pointer_cast<MapItem>(this->value);
-            if (map_item) {
-                for (const auto& ev : events) {
-                    if (ev->value) {
-                        map_item->map_value[ev->value->id] = ev->value;
-                    }
-                }
+            results.resize(events.size());
+            for (size_t i = 0; i < events.size(); ++i) {
+                results[i] = events[i]->value;
             }
             // assign the current time
-            self->sim_time = env.sim_time;
-            env.schedule(self);
+            sim_time = env.sim_time;
+            env.schedule(EventPtr<SimEventBase>(this));
         }
     }
 
     bool await_ready() const noexcept { return false; }
 
-    void await_suspend(std::coroutine_handle<> h, const std::string& label = "?") {
-        waiters.emplace_back(h, label);
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h, const DebugLabel& label = "?") {
+        waiters.emplace_back(process_of(h), label);
         // Set the current event on the task promise
         auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
         ht.promise().current_event = this;
-        auto self = shared_from_this();
         for (const std::shared_ptr<SimEvent>& e : events) {
-            if (e->done && dynamic_cast<SimDelay*>(e.get()) == nullptr) {
+            const bool is_delay = e->kind == EventKind::Delay;
+            if (e->done && !is_delay) {
                 this->count(env.sim_time);
-            } else if (auto* delay = dynamic_cast<SimDelay*>(e.get())) {
-                e->callbacks.emplace_back([weak_self = std::weak_ptr<AllOfEvent>(self)](int t) {
-                    if (auto s = weak_self.lock()) {
-                            s->count(t);
-                    }
-                });
-                delay->on_succeed();
-            } else {
-                e->callbacks.emplace_back([weak_self = std::weak_ptr<AllOfEvent>(self)](int t) {
-                    if (auto s = weak_self.lock()) {
-
-                            s->count(t);
-                    }
-                });
+                continue;
+            }
+            // Cancelled in the destructor, so the raw pointer never outlives this event.
+            subscriptions.push_back(e->callbacks.add([this](int t) { count(t); }));
+            if (is_delay) {
+                e->on_succeed();
             }
         }
+        return env.handoff();
     }
 
-    auto await_resume() const {
+    std::span<const std::shared_ptr<ItemBase>> await_resume() const {
         if (interrupted) {
             throw InterruptException(interrupt_cause);
         }
-        return value;
+        return results.span();
     }
 
     void resume() override {
-        for (const auto& [wh, label] : waiters) {
-            env.schedule(std::make_shared<CoroutineProcess>(env.sim_time, wh, "AllOfEvent::resume handler-> " + label));
+        for (const auto& [proc, label] : waiters) {
+            env.schedule_resume(env.sim_time, proc, "AllOfEvent::resume handler-> " + label);
         }
         waiters.clear();
     }
@@ -404,85 +745,103 @@ struct AllOfEvent : SimEvent, std::enable_shared_from_this<AllOfEvent> {
         if (done) return;
         done = true;
         this->sim_time = env.sim_time;
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
 
     // Override interrupt to mark as interrupted and remove callbacks from children
     void interrupt(std::shared_ptr<ItemBase> cause = nullptr) override {
         if (done) return;
+        unsubscribe();
+        for (auto& e : events) e->cancel_if_unobserved();
         interrupted = true;
         interrupt_cause = std::move(cause);
         done = true;
         sim_time = env.sim_time;
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
 };
 
 
 // Waits for *any* of a set of SimEvents to complete, then triggers itself.
+// co_await yields a span indexed by child position holding the value of the child that fired
+// first (its position is `winner`); the other entries are empty.
 struct AnyOfEvent : SimEvent, std::enable_shared_from_this<AnyOfEvent> {
     using SimEvent::SimEvent;  // inherit constructor
-    std::vector<std::shared_ptr<SimEvent>> events;
-    std::vector<std::pair<std::coroutine_handle<>, std::string>> waiters;
+    ConditionChildren events;
+    ConditionResults results;
+    InlineVector<CallbackHandle, 8> subscriptions;  // our callbacks on the children
+    std::vector<std::pair<ProcessHandle, DebugLabel>> waiters;
     bool triggered = false;
+    size_t winner = 0;
     CSimpyEnv& env;
 
     AnyOfEvent(CSimpyEnv& env_, std::vector<std::shared_ptr<SimEvent>> evts)
-        : SimEvent(env_), events(std::move(evts)), env(env_) {}
+        : SimEvent(env_), env(env_) {
+        events.reserve(evts.size());
+        for (auto& e : evts) events.push_back(std::move(e));
+    }
+    AnyOfEvent(CSimpyEnv& env_, std::initializer_list<std::shared_ptr<SimEvent>> evts)
+        : SimEvent(env_), events(evts), env(env_) {}
+
+    ~AnyOfEvent() override { unsubscribe(); }
 
-    void trigger_now(int time) {
+    void unsubscribe() {
+        for (auto& sub : subscriptions) sub.cancel();
+        subscriptions.clear();
+    }
+
+    std::shared_ptr<AnyOfEvent> pinned;
+    void on_first_ref() override { pinned = shared_from_this(); }
+    void on_last_ref() override { auto release = std::move(pinned); }
+
+    void trigger_now(size_t index, int time) {
         if (triggered) return; // prevent double trigger
         triggered = true;
+        winner = index;
+        results.resize(events.size());
+        results[index] = events[index]->value;
 
-        // Remove all callbacks from other events so they won't fire later
-        for (auto& e : events) {
-            e->callbacks.clear();
-        }
+        // Withdraw from the other children; their other subscribers are left alone, and copies
+        // nobody else waits for leave the queue.
+        unsubscribe();
+        for (auto& e : events) e->cancel_if_unobserved();
 
         // Schedule this AnyOfEvent
-        auto self = shared_from_this();
-        self->sim_time = time;
-        env.schedule(self);
+        sim_time = time;
+        env.schedule(EventPtr<SimEventBase>(this));
     }
 
     bool await_ready() const noexcept { return false; }
 
-    void await_suspend(std::coroutine_handle<> h, const std::string& label = "?") {
-        waiters.emplace_back(h, label);
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h, const DebugLabel& label = "?") {
+        waiters.emplace_back(process_of(h), label);
         // Set the current event on the task promise
         auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
         ht.promise().current_event = this;
-        auto self = shared_from_this();
-        for (auto& e : events) {
-            e->callbacks.emplace_back([weak_self = std::weak_ptr<AnyOfEvent>(self)](int t) {
-                if (auto s = weak_self.lock()) {
-
-                        s->trigger_now(t);
-                }
-            });
-
-            // Handle events that are already done
-            if (e->done && dynamic_cast<SimDelay*>(e.get()) == nullptr) {
-                // it still has callback to anyof event and is not a SimDelay
+        for (size_t i = 0; i < events.size(); ++i) {
+            auto& e = events[i];
+            // Cancelled in the destructor, so the raw pointer never outlives this event.
+            subscriptions.push_back(e->callbacks.add([this, i](int t) { trigger_now(i, t); }));
+
+            // Delays are scheduled now; other children that are already done still hold the
+            // callback above, so rescheduling them fires it.
+            if (e->kind == EventKind::Delay || e->done) {
                 e->on_succeed();
             }
-
-            if (auto* delay = dynamic_cast<SimDelay*>(e.get())) {
-                delay->on_succeed();
-            }
         }
+        return env.handoff();
     }
 
-    auto await_resume() const {
+    std::span<const std::shared_ptr<ItemBase>> await_resume() const {
         if (interrupted) {
             throw InterruptException(interrupt_cause);
         }
-        return std::string("any_done");
+        return results.span();
     }
 
     void resume() override {
-        for (const auto& [wh, label] : waiters) {
-            env.schedule(std::make_shared<CoroutineProcess>(env.sim_time, wh, "AnyOfEvent::resume handler-> " + label));
+        for (const auto& [proc, label] : waiters) {
+            env.schedule_resume(env.sim_time, proc, "AnyOfEvent::resume handler-> " + label);
         }
         waiters.clear();
     }
@@ -493,20 +852,134 @@ std::shared_ptr<Task> CSimpyEnv::create_task(F&& coroutine_func) {
     // Capture the callable into a heap-allocated std::function to ensure it lives
     auto func_holder = std::make_shared<std::decay_t<F>>(std::forward<F>(coroutine_func));
 
-    // Invoke via the stored function to avoid dangling references to temporaries
-    Task t = (*func_holder)();
+    // Invoke via the stored function to avoid dangling references to temporaries; the frame
+    // (and those of coroutines it calls directly) comes from this env's frame pool.
+    Task t = [&] {
+        FramePool::Scope scope(frame_pool);
+        return (*func_holder)();
+    }();
 
     auto sp = std::make_shared<Task>(std::move(t));
 
     auto ce = std::make_shared<SimEvent>(*this);
     (sp->h).promise().set_completion_event(ce);
-
-    active_tasks.push_back(sp);
-    active_functors.push_back(func_holder);
+    (sp->h).promise().self = add_process(sp, func_holder);
     return sp;
 }
 
 
+template<typename F, typename... Args>
+ProcessHandle CSimpyEnv::process(F&& fn, Args&&... args) {
+    using Fn = std::decay_t<F>;
+    std::shared_ptr<void> holder;
+    Task t = [&] {
+        FramePool::Scope scope(frame_pool);
+        if constexpr (std::is_lvalue_reference_v<F> || std::is_empty_v<Fn> || std::is_pointer_v<Fn>
+                      || std::is_function_v<std::remove_reference_t<F>>) {
+            return std::invoke(std::forward<F>(fn), std::forward<Args>(args)...);
+        } else {
+            // The frame refers to the callable's captures, so a temporary has to outlive it.
+            auto stored = std::make_shared<Fn>(std::forward<F>(fn));
+            holder = stored;
+            return std::invoke(*stored, std::forward<Args>(args)...);
+        }
+    }();
+    auto task = std::make_shared<Task>(std::move(t));
+    ProcessHandle proc = add_process(task, std::move(holder));
+    task->h.promise().self = proc;
+    schedule_resume(sim_time, proc);
+    return proc;
+}
+
+
+struct ResourceRequest;
+
+// Reneging timer of a request made with get_with_timeout/put_with_timeout. A bare queue entry
+// rather than a SimDelay: it withdraws the request when it comes due, and is cancelled in the
+// queue if the request is served first.
+struct RequestTimer final : SimEventBase {
+    ResourceRequest* request;
+
+    RequestTimer(CSimpyEnv& env, int t, ResourceRequest* r) : SimEventBase(env.next_event_id()), request(r) {
+        sim_time = t;
+    }
+    void resume() override;
+};
+
+// Container or Store request that can leave its resource's waiter list before it is served:
+// when it is interrupted, cancelled or times out. The resource records the request's position
+// in its waiter list, so withdrawing it is O(1).
+struct ResourceRequest : SimEvent {
+    bool waiting = false;    // in its resource's waiter list
+    bool timed_out = false;  // withdrawn by its timer; co_await then yields an empty result
+    EventPtr<RequestTimer> timer;
+
+    using SimEvent::SimEvent;
+    ~ResourceRequest() override { drop_timer(); }
+
+    // Removes the request from its waiter list; returns false if it was not waiting (already
+    // served, withdrawn, or never queued). Nobody is woken.
+    bool withdraw() {
+        if (!waiting) return false;
+        waiting = false;
+        drop_timer();
+        remove_waiter();
+        return true;
+    }
+
+    // Withdraws the request and wakes its waiter if it is still waiting `delay` from now.
+    void expire_after(int delay) {
+        drop_timer();
+        timer = env.make_event<RequestTimer>(env, env.sim_time + delay, this);
+        env.schedule(timer);
+    }
+
+    // Called by the resource when it hands the request what it asked for.
+    void served() {
+        waiting = false;
+        drop_timer();
+    }
+
+    void expire() {
+        EventPtr<ResourceRequest> keep(this);  // the waiter list may hold the last reference
+        timer.reset();
+        if (!withdraw()) return;
+        timed_out = true;
+        on_succeed();
+    }
+
+    void cancel() override {
+        EventPtr<ResourceRequest> keep(this);
+        withdraw();
+        SimEvent::cancel();
+    }
+
+    void interrupt(std::shared_ptr<ItemBase> cause = nullptr) override {
+        EventPtr<ResourceRequest> keep(this);
+        withdraw();
+        SimEvent::interrupt(std::move(cause));
+    }
+
+    void throw_if_interrupted() const {
+        if (interrupted) throw InterruptException(interrupt_cause);
+    }
+
+protected:
+    // Erases the request from its resource's waiter list.
+    virtual void remove_waiter() = 0;
+
+private:
+    void drop_timer() {
+        if (!timer) return;
+        env.cancel(*timer);
+        timer.reset();
+    }
+};
+
+inline void RequestTimer::resume() {
+    request->expire();
+}
+
 struct ContainerBase {
     virtual bool can_put(int value) const = 0;
     virtual bool can_get(int value) const = 0;
@@ -514,18 +987,46 @@ struct ContainerBase {
     virtual ~ContainerBase() = default;
 };
 
+// How a Container serves blocked requests. FirstFit serves every waiter whose amount fits, in
+// arrival order; Fifo stops at the first one that doesn't (head-of-line blocking, as in SimPy).
+enum class WaiterDiscipline { FirstFit, Fifo };
+
 struct Container : ContainerBase {
+    // A blocked request and its entry in pending_gets/pending_puts.
+    struct Waiter {
+        EventPtr<ResourceRequest> event;
+        int amount;
+        std::multiset<int>::iterator pending;
+    };
+    using Waiters = std::list<Waiter>;
+    // Where a blocked request sits, so it can be withdrawn without a search.
+    using Slot = Waiters::iterator;
+    // Level watchers by threshold (ContainerLevelEvent).
+    using LevelWatchers = std::multimap<int, EventPtr<ResourceRequest>>;
+
     CSimpyEnv& env;
     int level = 0;
     int capacity;
-    std::vector<std::pair<std::shared_ptr<SimEvent>, int>> get_waiters;
-    std::vector<std::pair<std::shared_ptr<SimEvent>, int>> put_waiters;
+    Waiters get_waiters;
+    Waiters put_waiters;
     std::string name;
+    WaiterDiscipline discipline;
+    uint32_t trace_id;
 
-    Container(CSimpyEnv& e, int cap, std::string n = "") : env(e), capacity(cap), name(std::move(n)) {}
+    Container(CSimpyEnv& e, int cap, std::string n = "", WaiterDiscipline d = WaiterDiscipline::FirstFit)
+        : env(e), capacity(cap), name(std::move(n)), discipline(d), trace_id(e.next_resource_id()) {}
 
     auto put(int value);
     auto get(int value);
+    // As put/get, but a request still blocked `timeout` from now is withdrawn; co_await then
+    // yields 0 and the event's timed_out is set.
+    auto put_with_timeout(int value, int timeout);
+    auto get_with_timeout(int value, int timeout);
+    // One-shot level conditions: fire once the level is below / at least `threshold` (at once if
+    // it already is), and co_await yields the level at that moment. Watchers are kept sorted by
+    // threshold, so a level change only visits the ones it satisfies.
+    auto when_level_below(int threshold);
+    auto when_level_at_least(int threshold);
 
     bool can_put(int value) const override {
         return level + value <= capacity;
@@ -534,25 +1035,42 @@ struct Container : ContainerBase {
         return level >= value;
     }
 
-    void await_get(std::shared_ptr<SimEvent> get_event, int value) {
-        get_waiters.emplace_back(std::move(get_event), value);
+    Slot await_get(EventPtr<ResourceRequest> get_event, int value) {
+        get_event->waiting = true;
+        return get_waiters.insert(get_waiters.end(), Waiter{std::move(get_event), value, pending_gets.insert(value)});
+    }
+
+    Slot await_put(EventPtr<ResourceRequest> put_event, int value) {
+        put_event->waiting = true;
+        return put_waiters.insert(put_waiters.end(), Waiter{std::move(put_event), value, pending_puts.insert(value)});
+    }
+
+    // Drop a withdrawn request. Under Fifo it may have been blocking the requests behind it.
+    void remove_get(Slot slot) {
+        pending_gets.erase(slot->pending);
+        get_waiters.erase(slot);
+        trigger_get();
     }
 
-    void await_put(std::shared_ptr<SimEvent> put_event, int value) {
-        put_waiters.emplace_back(std::move(put_event), value);
+    void remove_put(Slot slot) {
+        pending_puts.erase(slot->pending);
+        put_waiters.erase(slot);
+        trigger_put();
     }
 
     // Set/get for label (existing methods)
 
     void trigger_get() {
+        const int before = level;
         if (DEBUG_RESOURCE) {
             std::cout << "[" << name << "] 🔍 Get Waiters (before trying):\n";
-            for (const auto& [h, v] : get_waiters) {
-                std::cout << "[" << name << "]   - wants: " << v << "\n";
+            for (const auto& w : get_waiters) {
+                std::cout << "[" << name << "]   - wants: " << w.amount << "\n";
             }
         }
-        for (size_t i = 0; i < get_waiters.size();) {
-            auto& [get_event, v] = get_waiters[i];
+        // Nothing can be served while even the smallest pending request doesn't fit.
+        for (auto it = get_waiters.begin(); it != get_waiters.end() && can_get(*pending_gets.begin());) {
+            auto& [get_event, v, pending] = *it;
             if (can_get(v)) {
                 if (DEBUG_RESOURCE) {
                     std::cout << "[" << name << "]   - try get : " << v << "\t"<<"level b4:"<<level<<"\n";
@@ -561,145 +1079,189 @@ struct Container : ContainerBase {
                 if (DEBUG_RESOURCE) {
                     std::cout << "[" << name << "]   - tre get : " << v << "\t"<<"level after:"<<level<<"\n";
                 }
+                get_event->served();
                 get_event->on_succeed();
 
-                get_waiters.erase(get_waiters.begin() + i);
+                pending_gets.erase(pending);
+                it = get_waiters.erase(it);
+            } else if (discipline == WaiterDiscipline::Fifo) {
+                break;
             } else {
-                ++i;
+                ++it;
             }
         }
+        if (level != before) notify_level();
     }
 
     void trigger_put() {
+        const int before = level;
         if (DEBUG_RESOURCE) {
             std::cout << "[" << name << "] 🔍 Put Waiters (before trying):\n";
-            for (const auto& [h, v] : put_waiters) {
-                std::cout << "[" << name << "]   - wants to put: " << v << "\n";
+            for (const auto& w : put_waiters) {
+                std::cout << "[" << name << "]   - wants to put: " << w.amount << "\n";
             }
         }
-        for (size_t i = 0; i < put_waiters.size();) {
-            auto& [put_event, v] = put_waiters[i];
+        for (auto it = put_waiters.begin(); it != put_waiters.end() && can_put(*pending_puts.begin());) {
+            auto& [put_event, v, pending] = *it;
             if (can_put(v)) {
                 level += v;
+                put_event->served();
                 put_event->on_succeed();
-                put_waiters.erase(put_waiters.begin() + i);
+                pending_puts.erase(pending);
+                it = put_waiters.erase(it);
+            } else if (discipline == WaiterDiscipline::Fifo) {
+                break;
             } else {
-                ++i;
+                ++it;
             }
         }
+        if (level != before) notify_level();
     }
 
     // Set/get for level
-    void set_level(int l) { assert(l >= 0 && l <= capacity); level = l; }
+    void set_level(int l) {
+        assert(l >= 0 && l <= capacity);
+        level = l;
+        notify_level();
+    }
     int get_level() const { return level; }
+
+private:
+    // Amounts of the blocked requests; begin() is the smallest one.
+    std::multiset<int> pending_gets;
+    std::multiset<int> pending_puts;
+    LevelWatchers below_watchers;
+    LevelWatchers at_least_watchers;
+
+    auto watch_level(LevelWatchers& watchers, int threshold, bool met);
+    // Wakes the watchers whose condition the current level meets.
+    void notify_level();
 };
 
 
-struct ContainerPutEvent : SimEvent, std::enable_shared_from_this<ContainerPutEvent> {
+struct ContainerPutEvent : ResourceRequest {
     CSimpyEnv& env;
     Container& container;
     int value;
+    Container::Slot slot;  // valid while waiting
     ContainerPutEvent(CSimpyEnv& env_, Container& c, int v)
-    : SimEvent(env_), env(env_), container(c), value(v) {
+    : ResourceRequest(env_), env(env_), container(c), value(v) {
         sim_time = env.sim_time;
     }
 
     struct Awaiter {
-        std::shared_ptr<ContainerPutEvent> self;
+        EventPtr<ContainerPutEvent> self;
 
-        bool await_ready() const noexcept { return false; }
+        bool await_ready() const noexcept { return self->immediate; }
 
-        void await_suspend(std::coroutine_handle<> h) {
-            auto keep_alive = self; // make a copy of the shared_ptr
-            // Separate callback to resume coroutine
-            self->callbacks.emplace_back([keep_alive, h](int time) {
-                keep_alive->env.schedule(std::make_shared<CoroutineProcess>(time, h, "ContainerPut::callback -> "));
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            // Separate callback to resume coroutine; the queue keeps the event alive while it fires
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int time) {
+                env->schedule_resume(time, proc, "ContainerPut::callback -> ");
             });
             auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
             ht.promise().current_event = self.get();
+            return self->env.handoff();
         }
 
-        auto await_resume() { return self->value; }
+        int await_resume() {
+            self->throw_if_interrupted();
+            return self->timed_out ? 0 : self->value;
+        }
     };
 
 
 
     void trigger() {
-        for (auto& cb : callbacks) {
-            cb(env.sim_time);
-        }
-        callbacks.clear();
+        callbacks.fire(env.sim_time);
     }
 
     void resume() override {
         trigger();
     }
 
+protected:
+    void remove_waiter() override { container.remove_put(slot); }
+
+public:
     void on_succeed() override {
         assert(dynamic_cast<ContainerPutEvent*>(this) == this);
         done = true;
         this->sim_time = env.sim_time;
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
 
 };
 
 
 
-struct ContainerGetEvent : SimEvent, std::enable_shared_from_this<ContainerGetEvent> {
+struct ContainerGetEvent : ResourceRequest {
     CSimpyEnv& env;
     Container& container;
     int value;
+    Container::Slot slot;  // valid while waiting
     ContainerGetEvent(CSimpyEnv& env_, Container& c, int v)
-    : SimEvent(env_), env(env_), container(c), value(v) {
+    : ResourceRequest(env_), env(env_), container(c), value(v) {
         sim_time = env.sim_time;
     }
 
     struct Awaiter {
-        std::shared_ptr<ContainerGetEvent> self;
-
-        bool await_ready() const noexcept { return false; }
+        EventPtr<ContainerGetEvent> self;
 
-        void await_suspend(std::coroutine_handle<> h) {
-            auto keep_alive = self; // make a copy of the shared_ptr
+        bool await_ready() const noexcept { return self->immediate; }
 
-            // Separate callback to resume coroutine
-            self->callbacks.emplace_back([keep_alive, h](int time) {
-                keep_alive->env.schedule(std::make_shared<CoroutineProcess>(time, h, "ContainerGet::callback -> "));
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            // Separate callback to resume coroutine; the queue keeps the event alive while it fires
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int time) {
+                env->schedule_resume(time, proc, "ContainerGet::callback -> ");
             });
             auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
             ht.promise().current_event = self.get();
+            return self->env.handoff();
         }
 
-        auto await_resume() { return self->value; }
+        int await_resume() {
+            self->throw_if_interrupted();
+            return self->timed_out ? 0 : self->value;
+        }
     };
 
     void trigger() {
-        for (auto& cb : callbacks) {
-            cb(env.sim_time);
-        }
-        callbacks.clear();
+        callbacks.fire(env.sim_time);
     }
 
     void resume() override {
         trigger();
     }
+
+protected:
+    void remove_waiter() override { container.remove_get(slot); }
+
+public:
     void on_succeed() override {
         assert(dynamic_cast<ContainerGetEvent*>(this) == this);
         done = true;
         // Record the simulation time in the event itself
         this->sim_time = env.sim_time;
 
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
 };
 
 // Inline definitions for Container::put and Container::get
 inline auto Container::put(int value) {
-    auto put_event_ptr = std::make_shared<ContainerPutEvent>(env, *this, value);
-    await_put(put_event_ptr, value);
+    auto put_event_ptr = env.make_event<ContainerPutEvent>(env, *this, value);
+    env.trace(TraceKind::ContainerPut, env.sim_time, put_event_ptr->unique_id, env.current_process, trace_id);
+    if (env.immediate_requests && put_waiters.empty() && can_put(value)) {
+        level += value;
+        put_event_ptr->done = put_event_ptr->immediate = true;
+        notify_level();
+        trigger_get();
+        return put_event_ptr;
+    }
+    put_event_ptr->slot = await_put(put_event_ptr, value);
     // Trigger the opposite side first so any waiting getters can proceed.
-    put_event_ptr->callbacks.emplace_back([this](int) {
+    put_event_ptr->callbacks.add([this](int) {
         this->trigger_get();
     });
     // Try to fulfill puts immediately if possible.
@@ -708,10 +1270,18 @@ inline auto Container::put(int value) {
 }
 
 inline auto Container::get(int value) {
-    auto get_event_ptr = std::make_shared<ContainerGetEvent>(env, *this, value);
-    await_get(get_event_ptr, value);
+    auto get_event_ptr = env.make_event<ContainerGetEvent>(env, *this, value);
+    env.trace(TraceKind::ContainerGet, env.sim_time, get_event_ptr->unique_id, env.current_process, trace_id);
+    if (env.immediate_requests && get_waiters.empty() && can_get(value)) {
+        level -= value;
+        get_event_ptr->done = get_event_ptr->immediate = true;
+        notify_level();
+        trigger_put();
+        return get_event_ptr;
+    }
+    get_event_ptr->slot = await_get(get_event_ptr, value);
     // Trigger the opposite side first so any waiting putters can proceed.
-    get_event_ptr->callbacks.emplace_back([this](int) {
+    get_event_ptr->callbacks.add([this](int) {
         this->trigger_put();
     });
     // Try to fulfill gets immediately if possible.
@@ -719,8 +1289,220 @@ inline auto Container::get(int value) {
     return get_event_ptr;
 }
 
+// Level condition on a Container (when_level_below / when_level_at_least).
+struct ContainerLevelEvent : ResourceRequest {
+    Container& container;
+    int level = 0;  // the container's level when the condition was met
+    Container::LevelWatchers* watchers = nullptr;
+    Container::LevelWatchers::iterator entry;  // valid while waiting
+
+    ContainerLevelEvent(CSimpyEnv& env_, Container& c) : ResourceRequest(env_), container(c) {}
+
+    struct Awaiter {
+        EventPtr<ContainerLevelEvent> self;
+
+        bool await_ready() const noexcept { return self->immediate; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int time) {
+                env->schedule_resume(time, proc, "ContainerLevel::callback -> ");
+            });
+            auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
+            ht.promise().current_event = self.get();
+            return self->env.handoff();
+        }
+
+        int await_resume() {
+            self->throw_if_interrupted();
+            return self->timed_out ? self->container.level : self->level;
+        }
+    };
+
+    void on_succeed() override {
+        done = true;
+        sim_time = env.sim_time;
+        env.schedule(EventPtr<SimEventBase>(this));
+    }
+
+protected:
+    void remove_waiter() override { watchers->erase(entry); }
+};
+
+inline ContainerLevelEvent::Awaiter operator co_await(EventPtr<ContainerLevelEvent> event) {
+    return ContainerLevelEvent::Awaiter{event};
+}
+
+inline auto Container::watch_level(LevelWatchers& watchers, int threshold, bool met) {
+    auto ev = env.make_event<ContainerLevelEvent>(env, *this);
+    if (met) {
+        ev->level = level;
+        if (env.immediate_requests) ev->done = ev->immediate = true;
+        else ev->on_succeed();
+        return ev;
+    }
+    ev->waiting = true;
+    ev->watchers = &watchers;
+    ev->entry = watchers.emplace(threshold, ev);  // after equal thresholds: FIFO among them
+    return ev;
+}
+
+inline auto Container::when_level_below(int threshold) {
+    return watch_level(below_watchers, threshold, level < threshold);
+}
+
+inline auto Container::when_level_at_least(int threshold) {
+    return watch_level(at_least_watchers, threshold, level >= threshold);
+}
+
+inline void Container::notify_level() {
+    auto wake = [this](LevelWatchers& watchers, LevelWatchers::iterator first, LevelWatchers::iterator last) {
+        while (first != last) {
+            auto& watcher = static_cast<ContainerLevelEvent&>(*first->second);
+            watcher.level = level;
+            watcher.served();
+            watcher.on_succeed();
+            first = watchers.erase(first);
+        }
+    };
+    // Thresholds above the level are now met for "below", those up to it for "at least".
+    if (!below_watchers.empty()) wake(below_watchers, below_watchers.upper_bound(level), below_watchers.end());
+    if (!at_least_watchers.empty()) wake(at_least_watchers, at_least_watchers.begin(), at_least_watchers.upper_bound(level));
+}
+
+inline auto Container::put_with_timeout(int value, int timeout) {
+    auto put_event_ptr = put(value);
+    if (put_event_ptr->waiting) put_event_ptr->expire_after(timeout);
+    return put_event_ptr;
+}
+
+inline auto Container::get_with_timeout(int value, int timeout) {
+    auto get_event_ptr = get(value);
+    if (get_event_ptr->waiting) get_event_ptr->expire_after(timeout);
+    return get_event_ptr;
+}
+
+
+
+
+// Waiting requests grouped by priority (highest first), FIFO within a priority. Adding a waiter
+// is O(log P) for P distinct levels; taking, skipping or erasing one is O(1).
+template<typename Event>
+struct PriorityWaiters {
+    enum class Action { Serve, Skip, Stop };
+    using Levels = std::map<int, std::list<EventPtr<Event>>, std::greater<int>>;
+
+    // Where a waiter sits; stays valid until it is served or erased.
+    struct Position {
+        typename Levels::iterator level;
+        typename Levels::mapped_type::iterator entry;
+    };
+
+    Levels levels;
+    size_t count = 0;
 
+    Position push(Priority priority, EventPtr<Event> ev) {
+        auto level = levels.try_emplace(static_cast<int>(priority)).first;
+        level->second.push_back(std::move(ev));
+        ++count;
+        return {level, std::prev(level->second.end())};
+    }
+
+    void erase(Position pos) {
+        pos.level->second.erase(pos.entry);
+        --count;
+        if (pos.level->second.empty()) levels.erase(pos.level);
+    }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
 
+    // Offers each waiter, in service order, to visit(ev): Serve removes it, Skip leaves it in
+    // place, Stop ends the pass.
+    template<typename F>
+    void service(F&& visit) {
+        for (auto level = levels.begin(); level != levels.end();) {
+            auto& fifo = level->second;
+            for (auto it = fifo.begin(); it != fifo.end();) {
+                const Action action = visit(*it);
+                if (action == Action::Stop) return;
+                if (action == Action::Serve) {
+                    it = fifo.erase(it);
+                    --count;
+                } else {
+                    ++it;
+                }
+            }
+            level = fifo.empty() ? levels.erase(level) : std::next(level);
+        }
+    }
+};
+
+// Store::get filter held inline: predicates up to inline_size bytes live in the buffer, larger
+// ones on the heap. Calls go through one function pointer, with no std::function allocation.
+class ItemFilter {
+public:
+    static constexpr size_t inline_size = 48;
+
+    ItemFilter() = default;
+
+    template<typename Pred>
+        requires (!std::is_same_v<std::decay_t<Pred>, ItemFilter>)
+    ItemFilter(Pred&& pred) {
+        using P = std::decay_t<Pred>;
+        if constexpr (sizeof(P) <= inline_size && alignof(P) <= alignof(std::max_align_t)
+                      && std::is_nothrow_move_constructible_v<P>) {
+            new (buffer) P(std::forward<Pred>(pred));
+            call = [](const void* p, const std::shared_ptr<ItemBase>& item) {
+                return static_cast<bool>((*static_cast<const P*>(p))(item));
+            };
+            destroy = [](void* p) { static_cast<P*>(p)->~P(); };
+            relocate = [](void* from, void* to) {
+                new (to) P(std::move(*static_cast<P*>(from)));
+                static_cast<P*>(from)->~P();
+            };
+        } else {
+            *reinterpret_cast<P**>(buffer) = new P(std::forward<Pred>(pred));
+            call = [](const void* p, const std::shared_ptr<ItemBase>& item) {
+                return static_cast<bool>((**static_cast<P* const*>(p))(item));
+            };
+            destroy = [](void* p) { delete *static_cast<P**>(p); };
+            relocate = [](void* from, void* to) { *static_cast<P**>(to) = *static_cast<P**>(from); };
+        }
+    }
+
+    ItemFilter(ItemFilter&& other) noexcept { take(other); }
+    ItemFilter& operator=(ItemFilter&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+    ItemFilter(const ItemFilter&) = delete;
+    ItemFilter& operator=(const ItemFilter&) = delete;
+    ~ItemFilter() { reset(); }
+
+    explicit operator bool() const { return call != nullptr; }
+    bool operator()(const std::shared_ptr<ItemBase>& item) const { return call(buffer, item); }
+
+private:
+    alignas(std::max_align_t) unsigned char buffer[inline_size];
+    bool (*call)(const void*, const std::shared_ptr<ItemBase>&) = nullptr;
+    void (*destroy)(void*) = nullptr;
+    void (*relocate)(void*, void*) = nullptr;
+
+    void take(ItemFilter& other) {
+        if (!other.call) return;
+        other.relocate(other.buffer, buffer);
+        call = other.call;
+        destroy = other.destroy;
+        relocate = other.relocate;
+        other.call = nullptr;
+    }
+    void reset() {
+        if (call) destroy(buffer);
+        call = nullptr;
+    }
+};
 
 struct StorePutEvent;
 struct StoreGetEvent;
@@ -729,12 +1511,13 @@ struct Store {
     CSimpyEnv& env;
     size_t capacity;
     std::vector<std::shared_ptr<ItemBase>> items;
-    std::vector<std::shared_ptr<StoreGetEvent>> get_waiters;
-    std::vector<std::shared_ptr<StorePutEvent>> put_waiters;
+    PriorityWaiters<StoreGetEvent> get_waiters;
+    PriorityWaiters<StorePutEvent> put_waiters;
     std::string name;
+    uint32_t trace_id;
 
     Store(CSimpyEnv& e, size_t cap, std::string n = "")
-        : env(e), capacity(cap), name(std::move(n)) {}
+        : env(e), capacity(cap), name(std::move(n)), trace_id(e.next_resource_id()) {}
 
     bool can_put() const {
         return items.size() < capacity;
@@ -744,8 +1527,15 @@ struct Store {
         return !items.empty();
     }
 
-    void await_put(std::shared_ptr<StorePutEvent> put_event);
-    void await_get(std::shared_ptr<StoreGetEvent> get_event);
+    void await_put(EventPtr<StorePutEvent> put_event);
+    void await_get(EventPtr<StoreGetEvent> get_event);
+    // As put/get, but a request still blocked `timeout` from now is withdrawn; co_await then
+    // yields nullptr and the event's timed_out is set (a timed-out put keeps its item).
+    EventPtr<StorePutEvent> put_with_timeout(std::shared_ptr<ItemBase> item, int timeout, Priority priority = Priority::Low);
+    EventPtr<StoreGetEvent> get_with_timeout(int timeout, Priority priority = Priority::Low);
+    template<typename Pred>
+        requires std::is_invocable_r_v<bool, const std::decay_t<Pred>&, const std::shared_ptr<ItemBase>&>
+    EventPtr<StoreGetEvent> get_with_timeout(Pred&& pred, int timeout, Priority priority = Priority::Low);
     void trigger_put();
     void trigger_get();
     void print_items() const;
@@ -753,40 +1543,49 @@ struct Store {
     auto put(ItemBase& item, Priority priority = Priority::Low); // clone overload
     auto put(std::shared_ptr<ItemBase> item, Priority priority = Priority::Low); // take ownership overload
     auto get(std::shared_ptr<std::function<bool(const std::shared_ptr<ItemBase>&)>> filter_ptr, Priority priority = Priority::Low);
+    // Predicate overload: pred is called directly while no getter is waiting, and otherwise kept
+    // inline in the event (see ItemFilter), so a filtered get needs no std::function.
+    template<typename Pred>
+        requires std::is_invocable_r_v<bool, const std::decay_t<Pred>&, const std::shared_ptr<ItemBase>&>
+    EventPtr<StoreGetEvent> get(Pred&& pred, Priority priority = Priority::Low);
 private:
     auto _put_impl(std::shared_ptr<ItemBase> item, Priority priority);
+    EventPtr<StoreGetEvent> _get_impl(ItemFilter filter, Priority priority);
 
 
 };
 
 // StorePutEvent
-struct StorePutEvent : SimEvent, std::enable_shared_from_this<StorePutEvent> {
+struct StorePutEvent : ResourceRequest {
     CSimpyEnv& env;
     Store& store;
     std::shared_ptr<ItemBase> item;
     Priority priority;
+    PriorityWaiters<StorePutEvent>::Position position;  // valid while waiting
 
     StorePutEvent(CSimpyEnv& env_, Store& s, std::shared_ptr<ItemBase> it, Priority prio = Priority::Low)
-        : SimEvent(env_), env(env_), store(s), item(std::move(it)), priority(prio) {
+        : ResourceRequest(env_), env(env_), store(s), item(std::move(it)), priority(prio) {
         sim_time = env.sim_time;
     }
 
     struct Awaiter {
-        std::shared_ptr<StorePutEvent> self;
+        EventPtr<StorePutEvent> self;
 
-        bool await_ready() const noexcept { return false; }
+        bool await_ready() const noexcept { return self->immediate; }
 
-        void await_suspend(std::coroutine_handle<> h) {
-            auto keep_alive = self;
-            self->callbacks.emplace_back([keep_alive, h](int t) {
-                keep_alive->env.schedule(
-                    std::make_shared<CoroutineProcess>(t, h, "StorePut::callback -> "));
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int t) {
+                env->schedule_resume(t, proc, "StorePut::callback -> ");
             });
             auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
             ht.promise().current_event = self.get();
+            return self->env.handoff();
         }
 
-        auto await_resume() { return self->item; }
+        std::shared_ptr<ItemBase> await_resume() {
+            self->throw_if_interrupted();
+            return self->timed_out ? nullptr : self->item;
+        }
     };
 
     void resume() override { trigger(); }
@@ -797,40 +1596,44 @@ struct StorePutEvent : SimEvent, std::enable_shared_from_this<StorePutEvent> {
         assert(dynamic_cast<StorePutEvent*>(this) == this);
         done = true;
         this->sim_time = env.sim_time;
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
+
+protected:
+    void remove_waiter() override { store.put_waiters.erase(position); }
 };
 
 // StoreGetEvent
-struct StoreGetEvent : SimEvent, std::enable_shared_from_this<StoreGetEvent> {
+struct StoreGetEvent : ResourceRequest {
     CSimpyEnv& env;
     Store& store;
     Priority priority;
+    ItemFilter item_filter;
+    PriorityWaiters<StoreGetEvent>::Position position;  // valid while waiting
 
-    StoreGetEvent(CSimpyEnv& env_, Store& s,
-                  std::function<bool(const std::shared_ptr<ItemBase>&)> filter = {}, Priority prio = Priority::Low)
-        : SimEvent(env_), env(env_), store(s), priority(prio) {
+    StoreGetEvent(CSimpyEnv& env_, Store& s, ItemFilter filter = {}, Priority prio = Priority::Low)
+        : ResourceRequest(env_), env(env_), store(s), priority(prio), item_filter(std::move(filter)) {
         sim_time = env.sim_time;
-        item_filter = std::move(filter);
     }
 
     struct Awaiter {
-        std::shared_ptr<StoreGetEvent> self;
+        EventPtr<StoreGetEvent> self;
 
-        bool await_ready() const noexcept { return false; }
+        bool await_ready() const noexcept { return self->immediate; }
 
-        // Rewritten to avoid re-wrapping shared_ptr
-        void await_suspend(std::coroutine_handle<> h) {
-            auto keep_alive = self; // already a shared_ptr
-            self->callbacks.emplace_back([keep_alive, h](int t) {
-                keep_alive->env.schedule(
-                    std::make_shared<CoroutineProcess>(t, h, "StoreGet::callback -> "));
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int t) {
+                env->schedule_resume(t, proc, "StoreGet::callback -> ");
             });
             auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
             ht.promise().current_event = self.get();
+            return self->env.handoff();
         }
 
-        auto await_resume() { return self->value; }
+        std::shared_ptr<ItemBase> await_resume() {
+            self->throw_if_interrupted();
+            return self->value;
+        }
     };
 
     void resume() override { trigger(); }
@@ -841,32 +1644,42 @@ struct StoreGetEvent : SimEvent, std::enable_shared_from_this<StoreGetEvent> {
         assert(dynamic_cast<StoreGetEvent*>(this) == this);
         done = true;
         this->sim_time = env.sim_time;
-        env.schedule(shared_from_this());
+        env.schedule(EventPtr<SimEventBase>(this));
     }
+
+protected:
+    void remove_waiter() override { store.get_waiters.erase(position); }
 };
 
 
-inline StoreGetEvent::Awaiter operator co_await(std::shared_ptr<StoreGetEvent> event) {
+inline StoreGetEvent::Awaiter operator co_await(EventPtr<StoreGetEvent> event) {
     return StoreGetEvent::Awaiter{event};
 }
 
-inline StorePutEvent::Awaiter operator co_await(std::shared_ptr<StorePutEvent> event) {
+inline StorePutEvent::Awaiter operator co_await(EventPtr<StorePutEvent> event) {
     return StorePutEvent::Awaiter{event};
 }
 
-inline ContainerGetEvent::Awaiter operator co_await(std::shared_ptr<ContainerGetEvent> event) {
+inline ContainerGetEvent::Awaiter operator co_await(EventPtr<ContainerGetEvent> event) {
     return ContainerGetEvent::Awaiter{event};
 }
 
-inline ContainerPutEvent::Awaiter operator co_await(std::shared_ptr<ContainerPutEvent> event) {
+inline ContainerPutEvent::Awaiter operator co_await(EventPtr<ContainerPutEvent> event) {
     return ContainerPutEvent::Awaiter{event};
 }
 
 // Private helper for Store::put
 inline auto Store::_put_impl(std::shared_ptr<ItemBase> item, Priority priority) {
-    auto put_event_ptr = std::make_shared<StorePutEvent>(StorePutEvent(env, *this, std::move(item), priority));
+    auto put_event_ptr = env.make_event<StorePutEvent>(env, *this, std::move(item), priority);
+    env.trace(TraceKind::StorePut, env.sim_time, put_event_ptr->unique_id, env.current_process, trace_id);
+    if (env.immediate_requests && put_waiters.empty() && can_put()) {
+        items.push_back(put_event_ptr->item);
+        put_event_ptr->done = put_event_ptr->immediate = true;
+        trigger_get();
+        return put_event_ptr;
+    }
     await_put(put_event_ptr);
-    put_event_ptr->callbacks.emplace_back([this](int) {
+    put_event_ptr->callbacks.add([this](int) {
         this->trigger_get();
     });
     trigger_put();
@@ -884,10 +1697,56 @@ inline auto Store::put(std::shared_ptr<ItemBase> item, Priority priority) {
 
 // Overload taking a shared_ptr filter to extend filter lifetime
 inline auto Store::get(std::shared_ptr<std::function<bool(const std::shared_ptr<ItemBase>&)>> filter_ptr, Priority priority) {
-    std::function<bool(const std::shared_ptr<ItemBase>&)> filter = filter_ptr ? *filter_ptr : std::function<bool(const std::shared_ptr<ItemBase>&)>();
-    auto get_event_ptr = std::make_shared<StoreGetEvent>(env, *this, std::move(filter), priority);
+    if (!filter_ptr) return _get_impl(ItemFilter{}, priority);
+    // The shared_ptr keeps the caller's std::function alive and is small enough to sit inline.
+    return _get_impl(ItemFilter([filter_ptr](const std::shared_ptr<ItemBase>& item) { return (*filter_ptr)(item); }),
+                     priority);
+}
+
+template<typename Pred>
+    requires std::is_invocable_r_v<bool, const std::decay_t<Pred>&, const std::shared_ptr<ItemBase>&>
+EventPtr<StoreGetEvent> Store::get(Pred&& pred, Priority priority) {
+    if (get_waiters.empty()) {
+        // Nobody is ahead of this getter, so it can be matched right away with the concrete type.
+        auto it = std::find_if(items.begin(), items.end(),
+                               [&pred](const std::shared_ptr<ItemBase>& item) { return static_cast<bool>(pred(item)); });
+        if (it != items.end()) {
+            auto get_event_ptr = env.make_event<StoreGetEvent>(env, *this, ItemFilter{}, priority);
+            env.trace(TraceKind::StoreGet, env.sim_time, get_event_ptr->unique_id, env.current_process, trace_id);
+            get_event_ptr->set_value(std::move(*it));
+            items.erase(it);
+            if (env.immediate_requests) {
+                get_event_ptr->done = get_event_ptr->immediate = true;
+                trigger_put();
+                return get_event_ptr;
+            }
+            get_event_ptr->callbacks.add([this](int) {
+                this->trigger_put();
+            });
+            get_event_ptr->on_succeed();
+            return get_event_ptr;
+        }
+    }
+    return _get_impl(ItemFilter(std::forward<Pred>(pred)), priority);
+}
+
+inline EventPtr<StoreGetEvent> Store::_get_impl(ItemFilter filter, Priority priority) {
+    auto get_event_ptr = env.make_event<StoreGetEvent>(env, *this, std::move(filter), priority);
+    env.trace(TraceKind::StoreGet, env.sim_time, get_event_ptr->unique_id, env.current_process, trace_id);
+    if (env.immediate_requests && get_waiters.empty()) {
+        const ItemFilter& match = get_event_ptr->item_filter;
+        auto it = std::find_if(items.begin(), items.end(),
+                               [&match](const std::shared_ptr<ItemBase>& item) { return !match || match(item); });
+        if (it != items.end()) {
+            get_event_ptr->set_value(std::move(*it));
+            items.erase(it);
+            get_event_ptr->done = get_event_ptr->immediate = true;
+            trigger_put();
+            return get_event_ptr;
+        }
+    }
     await_get(get_event_ptr);
-    get_event_ptr->callbacks.emplace_back([this](int) {
+    get_event_ptr->callbacks.add([this](int) {
         this->trigger_put();
     });
     trigger_get();
@@ -896,53 +1755,66 @@ inline auto Store::get(std::shared_ptr<std::function<bool(const std::shared_ptr<
 
 
 // Inline definitions for Store methods
-inline void Store::await_put(std::shared_ptr<StorePutEvent> put_event) {
-    put_waiters.emplace_back(std::move(put_event));
+inline void Store::await_put(EventPtr<StorePutEvent> put_event) {
+    StorePutEvent& ev = *put_event;
+    ev.waiting = true;
+    ev.position = put_waiters.push(ev.priority, std::move(put_event));
 }
 
-inline void Store::await_get(std::shared_ptr<StoreGetEvent> get_event) {
-    get_waiters.emplace_back(std::move(get_event));
+inline void Store::await_get(EventPtr<StoreGetEvent> get_event) {
+    StoreGetEvent& ev = *get_event;
+    ev.waiting = true;
+    ev.position = get_waiters.push(ev.priority, std::move(get_event));
+}
+
+inline EventPtr<StorePutEvent> Store::put_with_timeout(std::shared_ptr<ItemBase> item, int timeout, Priority priority) {
+    auto put_event_ptr = _put_impl(std::move(item), priority);
+    if (put_event_ptr->waiting) put_event_ptr->expire_after(timeout);
+    return put_event_ptr;
+}
+
+inline EventPtr<StoreGetEvent> Store::get_with_timeout(int timeout, Priority priority) {
+    auto get_event_ptr = _get_impl(ItemFilter{}, priority);
+    if (get_event_ptr->waiting) get_event_ptr->expire_after(timeout);
+    return get_event_ptr;
+}
+
+template<typename Pred>
+    requires std::is_invocable_r_v<bool, const std::decay_t<Pred>&, const std::shared_ptr<ItemBase>&>
+EventPtr<StoreGetEvent> Store::get_with_timeout(Pred&& pred, int timeout, Priority priority) {
+    auto get_event_ptr = get(std::forward<Pred>(pred), priority);
+    if (get_event_ptr->waiting) get_event_ptr->expire_after(timeout);
+    return get_event_ptr;
 }
 
 inline void Store::trigger_put() {
-    std::sort(put_waiters.begin(), put_waiters.end(),
-        [](const std::shared_ptr<StorePutEvent>& a, const std::shared_ptr<StorePutEvent>& b) {
-            return static_cast<int>(a->priority) > static_cast<int>(b->priority);
-        });
-    for (size_t i = 0; i < put_waiters.size();) {
-        auto& evt = put_waiters[i];
-        if (can_put()) {
-            items.push_back(evt->item);
-            evt->on_succeed();
-            put_waiters.erase(put_waiters.begin() + i);
-        } else {
-            ++i;
-        }
-    }
+    using Action = PriorityWaiters<StorePutEvent>::Action;
+    put_waiters.service([this](const EventPtr<StorePutEvent>& evt) {
+        if (!can_put()) return Action::Stop;
+        items.push_back(evt->item);
+        evt->served();
+        evt->on_succeed();
+        return Action::Serve;
+    });
 }
 
 inline void Store::trigger_get() {
-    std::sort(get_waiters.begin(), get_waiters.end(),
-        [](const std::shared_ptr<StoreGetEvent>& a, const std::shared_ptr<StoreGetEvent>& b) {
-            return static_cast<int>(a->priority) > static_cast<int>(b->priority);
-        });
-    //std::cout << "waiter size "<<get_waiters.size()<<std::endl;
-    for (size_t i = 0; i < get_waiters.size();) {
-        auto& evt = get_waiters[i];
+    using Action = PriorityWaiters<StoreGetEvent>::Action;
+    // Filtered getters that match nothing are skipped, so later waiters can still be served.
+    get_waiters.service([this](const EventPtr<StoreGetEvent>& evt) {
+        if (items.empty()) return Action::Stop;
         auto it = std::find_if(items.begin(), items.end(),
                                [&evt](const std::shared_ptr<ItemBase>& item) {
                                    return !evt->item_filter || evt->item_filter(item);
                                });
-        if (it != items.end()) {
-            auto item = *it;
-            items.erase(it);
-            evt->set_value(item);
-            evt->on_succeed();
-            get_waiters.erase(get_waiters.begin() + i);
-            continue;
-        }
-        ++i;
-    }
+        if (it == items.end()) return Action::Skip;
+        auto item = *it;
+        items.erase(it);
+        evt->set_value(item);
+        evt->served();
+        evt->on_succeed();
+        return Action::Serve;
+    });
 }
 
 inline void Store::print_items() const {
@@ -954,10 +1826,11 @@ inline void Store::print_items() const {
 }
 
 // Out-of-line definition for SimEvent::await_suspend
-inline void SimEvent::await_suspend(std::coroutine_handle<> h, const std::string& label) {
-    callbacks.emplace_back([this, h, label](int time) {
-        env.schedule(std::make_shared<CoroutineProcess>(time, h, "SimEvent::callback -> " + label));
+inline std::coroutine_handle<> SimEvent::await_suspend(std::coroutine_handle<> h, const DebugLabel& label) {
+    callbacks.add([this, proc = process_of(h), label](int time) {
+        env.schedule_resume(time, proc, "SimEvent::callback -> " + label);
     });
     auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
     ht.promise().current_event = this;
+    return env.handoff();
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+//
+// Pooled storage and intrusive handles for scheduled events.
+//
+
+#ifndef EVENT_POOL_H
+#define EVENT_POOL_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Intrusive, non-atomic handle to an event. The pointee provides add_ref()/release_ref();
+// dropping the last reference to a pooled event hands its storage back to the EventPool.
+template<typename T>
+class EventPtr {
+public:
+    EventPtr() noexcept = default;
+    EventPtr(std::nullptr_t) noexcept {}
+    explicit EventPtr(T* raw) noexcept : ptr(raw) {
+        if (ptr) ptr->add_ref();
+    }
+
+    EventPtr(const EventPtr& other) noexcept : EventPtr(other.ptr) {}
+    EventPtr(EventPtr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    EventPtr(const EventPtr<U>& other) noexcept : EventPtr(other.get()) {}
+
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    EventPtr(EventPtr<U>&& other) noexcept : ptr(other.detach()) {}
+
+    ~EventPtr() { reset(); }
+
+    EventPtr& operator=(EventPtr other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    void reset() noexcept {
+        if (T* p = std::exchange(ptr, nullptr)) p->release_ref();
+    }
+
+    // Gives up ownership without releasing; the caller now holds the reference.
+    T* detach() noexcept { return std::exchange(ptr, nullptr); }
+
+    T* get() const noexcept { return ptr; }
+    T& operator*() const noexcept { return *ptr; }
+    T* operator->() const noexcept { return ptr; }
+    explicit operator bool() const noexcept { return ptr != nullptr; }
+
+    friend bool operator==(const EventPtr& a, const EventPtr& b) noexcept { return a.ptr == b.ptr; }
+    friend bool operator==(const EventPtr& a, std::nullptr_t) noexcept { return a.ptr == nullptr; }
+
+    // Interop with APIs that still take std::shared_ptr (e.g. the AllOfEvent child list).
+    // The shared_ptr holds one intrusive reference for as long as it lives.
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<T*, U*>>>
+    operator std::shared_ptr<U>() const {
+        if (!ptr) return {};
+        return std::shared_ptr<U>(ptr, [ref = *this](U*) mutable { ref.reset(); });
+    }
+
+private:
+    T* ptr = nullptr;
+};
+
+
+// Size-classed free lists for the events owned by one CSimpyEnv. Storage is only given back
+// to the heap when the pool is destroyed, so steady-state scheduling never touches malloc.
+class EventPool {
+public:
+    static constexpr std::size_t granule = 32;
+    static constexpr std::size_t num_classes = 16;  // objects up to 512 bytes are pooled
+    static constexpr std::uint8_t unpooled = 0xFF;
+
+    struct Stats {
+        std::size_t heap_allocations = 0;  // blocks obtained from operator new
+        std::size_t reused = 0;            // allocations served from a free list
+        std::size_t live = 0;              // blocks currently handed out
+    };
+
+    EventPool() = default;
+    EventPool(const EventPool&) = delete;
+    EventPool& operator=(const EventPool&) = delete;
+
+    ~EventPool() {
+        for (FreeNode*& head : free_lists) {
+            while (head) {
+                FreeNode* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    }
+
+    void* allocate(std::size_t size, std::uint8_t& size_class) {
+        ++counters.live;
+        const std::size_t cls = (size + granule - 1) / granule - 1;
+        if (cls >= num_classes) {
+            size_class = unpooled;
+            ++counters.heap_allocations;
+            return ::operator new(size);
+        }
+        size_class = static_cast<std::uint8_t>(cls);
+        if (FreeNode* node = free_lists[cls]) {
+            free_lists[cls] = node->next;
+            ++counters.reused;
+            return node;
+        }
+        ++counters.heap_allocations;
+        return ::operator new((cls + 1) * granule);
+    }
+
+    void deallocate(void* p, std::uint8_t size_class) noexcept {
+        --counters.live;
+        if (size_class == unpooled) {
+            ::operator delete(p);
+            return;
+        }
+        auto* node = static_cast<FreeNode*>(p);
+        node->next = free_lists[size_class];
+        free_lists[size_class] = node;
+    }
+
+    const Stats& stats() const noexcept { return counters; }
+
+private:
+    struct FreeNode { FreeNode* next; };
+    std::array<FreeNode*, num_classes> free_lists{};
+    Stats counters;
+};
+
+#endif //EVENT_POOL_H
@@ -0,0 +1,573 @@
+//
+// Future-event-set backends for CSimpyEnv.
+//
+// Every backend orders entries by (time, seq) and keeps the key inline next to the payload,
+// so comparisons never chase a pointer. All of them produce the exact same pop order; they
+// only differ in cost profile:
+//   - DAryHeap (QuadHeap/BinaryHeap): general purpose, O(log n), cache friendly.
+//   - PairingHeap: O(1) push, amortised O(log n) pop; good for bursty schedules.
+//   - CalendarQueue: O(1) expected when event times are spread evenly.
+//   - TimingWheel: hierarchical wheel over integer time, O(1) for small delays.
+//
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum class QueueKind { QuadHeap, BinaryHeap, PairingHeap, CalendarQueue, TimingWheel };
+
+inline const char* to_string(QueueKind kind) {
+    switch (kind) {
+        case QueueKind::QuadHeap: return "quad_heap";
+        case QueueKind::BinaryHeap: return "binary_heap";
+        case QueueKind::PairingHeap: return "pairing_heap";
+        case QueueKind::CalendarQueue: return "calendar_queue";
+        case QueueKind::TimingWheel: return "timing_wheel";
+    }
+    return "?";
+}
+
+struct EventKey {
+    int time;
+    size_t seq;
+
+    friend bool operator<(const EventKey& a, const EventKey& b) {
+        if (a.time != b.time) return a.time < b.time;
+        return a.seq < b.seq;
+    }
+};
+
+template<typename Payload>
+struct QueueEntry {
+    EventKey key;
+    Payload payload;
+};
+
+// Runtime-selectable interface used by CSimpyEnv.
+template<typename Payload>
+class FutureEventSet {
+public:
+    using Entry = QueueEntry<Payload>;
+    virtual ~FutureEventSet() = default;
+    virtual void push(EventKey key, Payload payload) = 0;
+    virtual const Entry& top() = 0;
+    virtual Entry pop() = 0;
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+
+    // Drops every entry pred(entry) selects and keeps the rest. The set is drained in key order
+    // and the survivors pushed back, which works for any backend in O(n log n); callers batch
+    // removals so the cost is amortised.
+    template<typename Pred>
+    size_t remove_if(Pred pred) {
+        std::vector<Entry> keep;
+        keep.reserve(size());
+        size_t removed = 0;
+        while (!empty()) {
+            Entry entry = pop();
+            if (pred(entry)) {
+                ++removed;
+            } else {
+                keep.push_back(std::move(entry));
+            }
+        }
+        for (Entry& entry : keep) push(entry.key, std::move(entry.payload));
+        return removed;
+    }
+};
+
+
+// d-ary min-heap over a contiguous vector of entries.
+template<typename Payload, unsigned Arity = 4>
+class DAryHeap {
+public:
+    using Entry = QueueEntry<Payload>;
+
+    void push(EventKey key, Payload payload) {
+        heap.push_back(Entry{key, std::move(payload)});
+        sift_up(heap.size() - 1);
+    }
+
+    const Entry& top() const { return heap.front(); }
+
+    Entry pop() {
+        Entry out = std::move(heap.front());
+        if (heap.size() > 1) {
+            Entry last = std::move(heap.back());
+            heap.pop_back();
+            sift_down(std::move(last));
+        } else {
+            heap.pop_back();
+        }
+        return out;
+    }
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    void reserve(size_t n) { heap.reserve(n); }
+
+private:
+    std::vector<Entry> heap;
+
+    void sift_up(size_t i) {
+        Entry moving = std::move(heap[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / Arity;
+            if (!(moving.key < heap[parent].key)) break;
+            heap[i] = std::move(heap[parent]);
+            i = parent;
+        }
+        heap[i] = std::move(moving);
+    }
+
+    // Places `moving` starting from the root hole.
+    void sift_down(Entry moving) {
+        const size_t n = heap.size();
+        size_t i = 0;
+        for (;;) {
+            size_t first = i * Arity + 1;
+            if (first >= n) break;
+            size_t last = std::min(first + Arity, n);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c) {
+                if (heap[c].key < heap[best].key) best = c;
+            }
+            if (!(heap[best].key < moving.key)) break;
+            heap[i] = std::move(heap[best]);
+            i = best;
+        }
+        heap[i] = std::move(moving);
+    }
+};
+
+template<typename Payload>
+using QuadHeap = DAryHeap<Payload, 4>;
+template<typename Payload>
+using BinaryHeap = DAryHeap<Payload, 2>;
+
+
+// Pairing heap with nodes kept in an index-linked arena (no per-node allocation).
+template<typename Payload>
+class PairingHeap {
+public:
+    using Entry = QueueEntry<Payload>;
+
+    void push(EventKey key, Payload payload) {
+        uint32_t n = new_node(Entry{key, std::move(payload)});
+        root = (root == nil) ? n : meld(root, n);
+        ++count;
+    }
+
+    const Entry& top() const { return nodes[root].entry; }
+
+    Entry pop() {
+        uint32_t old = root;
+        Entry out = std::move(nodes[old].entry);
+        root = merge_children(nodes[old].child);
+        free_node(old);
+        --count;
+        return out;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    void reserve(size_t n) { nodes.reserve(n); }
+
+private:
+    static constexpr uint32_t nil = UINT32_MAX;
+    struct Node {
+        Entry entry;
+        uint32_t child = nil;
+        uint32_t sibling = nil;
+    };
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_ids;
+    std::vector<uint32_t> scratch;
+    uint32_t root = nil;
+    size_t count = 0;
+
+    uint32_t new_node(Entry e) {
+        if (!free_ids.empty()) {
+            uint32_t id = free_ids.back();
+            free_ids.pop_back();
+            nodes[id].entry = std::move(e);
+            nodes[id].child = nodes[id].sibling = nil;
+            return id;
+        }
+        nodes.push_back(Node{std::move(e)});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void free_node(uint32_t id) {
+        nodes[id].entry.payload = Payload{};
+        free_ids.push_back(id);
+    }
+
+    uint32_t meld(uint32_t a, uint32_t b) {
+        if (nodes[b].entry.key < nodes[a].entry.key) std::swap(a, b);
+        nodes[b].sibling = nodes[a].child;
+        nodes[a].child = b;
+        return a;
+    }
+
+    // Standard two-pass merge: pair left to right, then fold right to left.
+    uint32_t merge_children(uint32_t first) {
+        if (first == nil) return nil;
+        scratch.clear();
+        while (first != nil) {
+            uint32_t a = first;
+            uint32_t b = nodes[a].sibling;
+            if (b == nil) {
+                nodes[a].sibling = nil;
+                scratch.push_back(a);
+                break;
+            }
+            first = nodes[b].sibling;
+            nodes[a].sibling = nodes[b].sibling = nil;
+            scratch.push_back(meld(a, b));
+        }
+        uint32_t result = scratch.back();
+        for (size_t i = scratch.size() - 1; i-- > 0;) {
+            result = meld(scratch[i], result);
+        }
+        return result;
+    }
+};
+
+
+// Brown's calendar queue. Each bucket is a small (time, seq) min-heap so heavy ties at one
+// time stay O(log k); the bucket count doubles/halves with the population and the bucket
+// width is re-estimated from the spread of pending times on every resize.
+template<typename Payload>
+class CalendarQueue {
+public:
+    using Entry = QueueEntry<Payload>;
+
+    CalendarQueue() { buckets.resize(min_buckets); }
+
+    void push(EventKey key, Payload payload) {
+        // A peek may have parked the window past this entry; re-anchor it.
+        if (key.time < window_top - width) set_window(key.time);
+        floor_time = std::min(floor_time, key.time);
+        auto& b = buckets[bucket_of(key.time)];
+        b.push_back(Entry{key, std::move(payload)});
+        std::push_heap(b.begin(), b.end(), later);
+        ++count;
+        if (count > 2 * buckets.size()) resize(buckets.size() * 2);
+    }
+
+    const Entry& top() { return buckets[locate()].front(); }
+
+    Entry pop() {
+        auto& b = buckets[locate()];
+        std::pop_heap(b.begin(), b.end(), later);
+        Entry out = std::move(b.back());
+        b.pop_back();
+        --count;
+        floor_time = out.key.time;
+        if (buckets.size() > min_buckets && count < buckets.size() / 2) resize(buckets.size() / 2);
+        return out;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+private:
+    static constexpr size_t min_buckets = 16;
+    static constexpr auto later = [](const Entry& a, const Entry& b) { return b.key < a.key; };
+
+    std::vector<std::vector<Entry>> buckets;
+    size_t count = 0;
+    long long width = 1;
+    size_t current = 0;          // bucket holding the window [window_top - width, window_top)
+    long long window_top = 1;
+    int floor_time = 0;          // no pending entry is earlier than this
+
+    size_t bucket_of(long long t) const {
+        return static_cast<size_t>((t / width) & static_cast<long long>(buckets.size() - 1));
+    }
+
+    void set_window(long long t) {
+        current = bucket_of(t);
+        window_top = (t / width + 1) * width;
+    }
+
+    // Finds the bucket holding the minimum entry and parks the window on it.
+    size_t locate() {
+        assert(count > 0);
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            const auto& b = buckets[current];
+            if (!b.empty() && b.front().key.time < window_top) return current;
+            current = (current + 1) & (buckets.size() - 1);
+            window_top += width;
+        }
+        // Nothing due within a full year: jump straight to the earliest entry.
+        size_t best = buckets.size();
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            if (!buckets[i].empty() && (best == buckets.size() || buckets[i].front().key < buckets[best].front().key)) {
+                best = i;
+            }
+        }
+        set_window(buckets[best].front().key.time);
+        return current;
+    }
+
+    void resize(size_t new_size) {
+        std::vector<Entry> all;
+        all.reserve(count);
+        long long lo = 0, hi = 0;
+        bool first = true;
+        for (auto& b : buckets) {
+            for (auto& e : b) {
+                lo = first ? e.key.time : std::min<long long>(lo, e.key.time);
+                hi = first ? e.key.time : std::max<long long>(hi, e.key.time);
+                first = false;
+                all.push_back(std::move(e));
+            }
+            b.clear();
+        }
+        // Aim for roughly three events per bucket-width, as in Brown's original scheme.
+        width = all.empty() ? 1 : std::max<long long>(1, 3 * (hi - lo) / static_cast<long long>(all.size()));
+        buckets.assign(new_size, {});
+        for (auto& e : all) {
+            auto& b = buckets[bucket_of(e.key.time)];
+            b.push_back(std::move(e));
+            std::push_heap(b.begin(), b.end(), later);
+        }
+        set_window(floor_time);
+    }
+};
+
+
+// Hierarchical timing wheel over non-negative integer time: four levels of 256 slots cover
+// the whole 32-bit range relative to the wheel's cursor. A level-0 slot holds a single time
+// value and is kept as a seq-ordered heap; higher levels are cascaded down when the cursor
+// reaches them. Entries earlier than the cursor (only possible after a peek) go to a small
+// side heap that is merged at pop time.
+template<typename Payload>
+class TimingWheel {
+public:
+    using Entry = QueueEntry<Payload>;
+
+    void push(EventKey key, Payload payload) {
+        ++count;
+        if (key.time < 0 || static_cast<uint32_t>(key.time) < cursor) {
+            early.push(key, std::move(payload));
+            return;
+        }
+        place(Entry{key, std::move(payload)});
+    }
+
+    const Entry& top() {
+        if (front_is_early()) return early.top();
+        return wheel_front();
+    }
+
+    Entry pop() {
+        --count;
+        if (front_is_early()) return early.pop();
+        wheel_front();
+        auto& slot = levels[0][cursor & slot_mask];
+        std::pop_heap(slot.begin(), slot.end(), later);
+        Entry out = std::move(slot.back());
+        slot.pop_back();
+        if (slot.empty()) clear_bit(0, cursor & slot_mask);
+        --wheel_count;
+        return out;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+private:
+    static constexpr unsigned num_levels = 4;
+    static constexpr unsigned slot_bits = 8;
+    static constexpr uint32_t slot_mask = (1u << slot_bits) - 1;
+    static constexpr auto later = [](const Entry& a, const Entry& b) { return b.key < a.key; };
+
+    std::array<std::array<std::vector<Entry>, 1u << slot_bits>, num_levels> levels;
+    std::array<std::array<uint64_t, 4>, num_levels> occupied{};
+    DAryHeap<Payload, 4> early;
+    uint32_t cursor = 0;
+    size_t count = 0;
+    size_t wheel_count = 0;
+
+    bool front_is_early() {
+        if (early.empty()) return false;
+        return wheel_count == 0 || early.top().key < wheel_front().key;
+    }
+
+    static unsigned level_for(uint32_t t, uint32_t cur) {
+        uint32_t diff = t ^ cur;
+        if (diff == 0) return 0;
+        return static_cast<unsigned>((31 - std::countl_zero(diff)) / slot_bits);
+    }
+
+    void set_bit(unsigned level, uint32_t slot) { occupied[level][slot >> 6] |= (uint64_t{1} << (slot & 63)); }
+    void clear_bit(unsigned level, uint32_t slot) { occupied[level][slot >> 6] &= ~(uint64_t{1} << (slot & 63)); }
+
+    // First occupied slot index >= from at the given level, or -1.
+    int next_slot(unsigned level, uint32_t from) const {
+        for (uint32_t word = from >> 6; word < 4; ++word) {
+            uint64_t bits = occupied[level][word];
+            if (word == (from >> 6)) bits &= ~uint64_t{0} << (from & 63);
+            if (bits) return static_cast<int>(word * 64 + std::countr_zero(bits));
+        }
+        return -1;
+    }
+
+    void place(Entry e) {
+        uint32_t t = static_cast<uint32_t>(e.key.time);
+        unsigned level = level_for(t, cursor);
+        uint32_t slot = (t >> (level * slot_bits)) & slot_mask;
+        auto& bucket = levels[level][slot];
+        bucket.push_back(std::move(e));
+        if (level == 0) std::push_heap(bucket.begin(), bucket.end(), later);
+        set_bit(level, slot);
+        ++wheel_count;
+    }
+
+    // Advances the cursor (cascading higher levels) until level 0 holds the minimum.
+    Entry& wheel_front() {
+        assert(wheel_count > 0);
+        for (;;) {
+            int s = next_slot(0, cursor & slot_mask);
+            if (s >= 0) {
+                cursor = (cursor & ~slot_mask) | static_cast<uint32_t>(s);
+                return levels[0][s].front();
+            }
+            unsigned level = 1;
+            for (; level < num_levels; ++level) {
+                uint32_t idx = (cursor >> (level * slot_bits)) & slot_mask;
+                if (idx == slot_mask) continue;
+                s = next_slot(level, idx + 1);
+                if (s >= 0) break;
+            }
+            assert(level < num_levels);
+            const unsigned shift = level * slot_bits;
+            const uint32_t keep_mask = (shift + slot_bits >= 32) ? 0u : ~((1u << (shift + slot_bits)) - 1);
+            cursor = (cursor & keep_mask) | (static_cast<uint32_t>(s) << shift);
+            std::vector<Entry> moved = std::move(levels[level][s]);
+            levels[level][s].clear();
+            clear_bit(level, static_cast<uint32_t>(s));
+            wheel_count -= moved.size();
+            for (auto& e : moved) place(std::move(e));
+        }
+    }
+};
+
+
+// Growable FIFO ring buffer (power-of-two capacity) used for the same-timestamp lane and
+// TypedStore's items.
+template<typename T>
+class FifoRing {
+public:
+    void push_back(T value) {
+        if (count == slots.size()) grow();
+        slots[(head + count) & (slots.size() - 1)] = std::move(value);
+        ++count;
+    }
+
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+    const T& back() const { return slots[(head + count - 1) & (slots.size() - 1)]; }
+
+    T pop_front() {
+        T out = std::move(slots[head]);
+        head = (head + 1) & (slots.size() - 1);
+        --count;
+        return out;
+    }
+
+    // Removes the elements pred(element) selects, keeping the others in order.
+    template<typename Pred>
+    size_t remove_if(Pred pred) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i) {
+            T& value = (*this)[i];
+            if (pred(value)) continue;
+            if (kept != i) (*this)[kept] = std::move(value);
+            ++kept;
+        }
+        const size_t removed = count - kept;
+        for (size_t i = kept; i < count; ++i) (*this)[i] = T{};
+        count = kept;
+        return removed;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    // i-th entry from the front.
+    T& operator[](size_t i) { return slots[(head + i) & (slots.size() - 1)]; }
+
+    // Removes and returns the i-th entry, shifting the entries behind it forward.
+    T take(size_t i) {
+        if (i == 0) return pop_front();
+        T out = std::move((*this)[i]);
+        for (size_t j = i + 1; j < count; ++j) (*this)[j - 1] = std::move((*this)[j]);
+        --count;
+        return out;
+    }
+
+    // Visits entries front to back.
+    template<typename F>
+    void for_each(F&& f) const {
+        for (size_t i = 0; i < count; ++i) f(slots[(head + i) & (slots.size() - 1)]);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+
+    void grow() {
+        std::vector<T> bigger(slots.empty() ? 16 : slots.size() * 2);
+        for (size_t i = 0; i < count; ++i) bigger[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        slots = std::move(bigger);
+        head = 0;
+    }
+};
+
+
+// Adapts a concrete backend to the runtime FutureEventSet interface.
+template<typename Backend, typename Payload>
+class FutureEventSetAdapter final : public FutureEventSet<Payload> {
+public:
+    using Entry = QueueEntry<Payload>;
+    void push(EventKey key, Payload payload) override { impl.push(key, std::move(payload)); }
+    const Entry& top() override { return impl.top(); }
+    Entry pop() override { return impl.pop(); }
+    bool empty() const override { return impl.empty(); }
+    size_t size() const override { return impl.size(); }
+private:
+    Backend impl;
+};
+
+template<typename Payload>
+std::unique_ptr<FutureEventSet<Payload>> make_future_event_set(QueueKind kind) {
+    switch (kind) {
+        case QueueKind::BinaryHeap:
+            return std::make_unique<FutureEventSetAdapter<BinaryHeap<Payload>, Payload>>();
+        case QueueKind::PairingHeap:
+            return std::make_unique<FutureEventSetAdapter<PairingHeap<Payload>, Payload>>();
+        case QueueKind::CalendarQueue:
+            return std::make_unique<FutureEventSetAdapter<CalendarQueue<Payload>, Payload>>();
+        case QueueKind::TimingWheel:
+            return std::make_unique<FutureEventSetAdapter<TimingWheel<Payload>, Payload>>();
+        case QueueKind::QuadHeap:
+        default:
+            return std::make_unique<FutureEventSetAdapter<QuadHeap<Payload>, Payload>>();
+    }
+}
+
+#endif //EVENT_QUEUE_H
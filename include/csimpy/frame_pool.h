@@ -0,0 +1,143 @@
+//
+// Size-bucketed arena for coroutine frames, used by TaskPromise::operator new.
+//
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Frames are carved from 64 KiB chunks into 64-byte size buckets; a destroyed frame goes onto its
+// bucket's free list for the next task of similar size. Chunks are only given back when the pool
+// is destroyed, all at once. Frames above 2 KiB come straight from operator new.
+//
+// A coroutine's operator new cannot see which environment it belongs to, so the pool in use is
+// a thread-local "current" pool: CSimpyEnv::create_task installs its own pool (FramePool::Scope)
+// while it builds the task. Frames allocated outside any scope use plain operator new.
+class FramePool {
+public:
+    static constexpr std::size_t granule = 64;
+    static constexpr std::size_t num_buckets = 32;
+    static constexpr std::size_t chunk_bytes = 64 * 1024;
+
+    struct Stats {
+        std::size_t allocations = 0;       // frames handed out
+        std::size_t reused = 0;            // frames served from a free list
+        std::size_t heap_allocations = 0;  // chunks and oversized frames from operator new
+        std::size_t live = 0;              // frames currently in use
+    };
+
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Releases every chunk. Frames still alive at this point would dangle, so in that case the
+    // chunks are deliberately leaked instead.
+    ~FramePool() {
+        if (counters.live != 0) return;
+        for (void* chunk : chunks) ::operator delete(chunk);
+    }
+
+    // Makes `pool` the current pool of this thread for its lifetime.
+    class Scope {
+    public:
+        explicit Scope(FramePool& pool) : previous(std::exchange(current(), &pool)) {}
+        ~Scope() { current() = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FramePool* previous;
+    };
+
+    static FramePool*& current() {
+        thread_local FramePool* pool = nullptr;
+        return pool;
+    }
+
+    // Entry points for TaskPromise::operator new/delete.
+    static void* allocate_frame(std::size_t size) {
+        if (FramePool* pool = current()) return pool->allocate(size);
+        auto* header = static_cast<Header*>(::operator new(sizeof(Header) + size));
+        header->pool = nullptr;
+        return header + 1;
+    }
+
+    static void deallocate_frame(void* frame) noexcept {
+        auto* header = static_cast<Header*>(frame) - 1;
+        if (header->pool) header->pool->deallocate(header);
+        else ::operator delete(header);
+    }
+
+    const Stats& stats() const noexcept { return counters; }
+
+private:
+    static constexpr std::uint32_t oversized = 0xFFFFFFFF;
+
+    // Precedes every frame; keeps the frame itself max-aligned.
+    struct alignas(std::max_align_t) Header {
+        FramePool* pool;
+        std::uint32_t bucket;
+    };
+    struct FreeNode { FreeNode* next; };
+
+    void* allocate(std::size_t size) {
+        ++counters.allocations;
+        ++counters.live;
+        const std::size_t bucket = (sizeof(Header) + size + granule - 1) / granule - 1;
+        Header* header;
+        if (bucket >= num_buckets) {
+            ++counters.heap_allocations;
+            header = static_cast<Header*>(::operator new(sizeof(Header) + size));
+            header->bucket = oversized;
+        } else {
+            if (FreeNode* node = free_lists[bucket]) {
+                free_lists[bucket] = node->next;
+                ++counters.reused;
+                header = reinterpret_cast<Header*>(node);
+            } else {
+                header = static_cast<Header*>(carve((bucket + 1) * granule));
+            }
+            header->bucket = static_cast<std::uint32_t>(bucket);
+        }
+        header->pool = this;
+        return header + 1;
+    }
+
+    void deallocate(Header* header) noexcept {
+        --counters.live;
+        if (header->bucket == oversized) {
+            ::operator delete(header);
+            return;
+        }
+        auto* node = reinterpret_cast<FreeNode*>(header);
+        node->next = free_lists[header->bucket];
+        free_lists[header->bucket] = node;
+    }
+
+    // Bump-allocates from the current chunk, starting a new one when it runs out.
+    void* carve(std::size_t bytes) {
+        if (chunk_left < bytes) {
+            ++counters.heap_allocations;
+            chunks.push_back(::operator new(chunk_bytes));
+            chunk_next = static_cast<unsigned char*>(chunks.back());
+            chunk_left = chunk_bytes;
+        }
+        void* block = chunk_next;
+        chunk_next += bytes;
+        chunk_left -= bytes;
+        return block;
+    }
+
+    std::array<FreeNode*, num_buckets> free_lists{};
+    std::vector<void*> chunks;
+    unsigned char* chunk_next = nullptr;
+    std::size_t chunk_left = 0;
+    Stats counters;
+};
+
+#endif //FRAME_POOL_H
@@ -0,0 +1,322 @@
+//
+// Store variant with key indexes, for large pools where gets are by id, name or a user field.
+//
+
+#ifndef INDEXED_STORE_H
+#define INDEXED_STORE_H
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "csimpy_env.h"
+
+// Key produced by an index extractor: integral fields (id, skill level) or strings (name, role).
+using IndexKey = std::variant<long long, std::string>;
+
+struct IndexKeyHash {
+    size_t operator()(const IndexKey& key) const {
+        return std::visit([](const auto& v) { return std::hash<std::decay_t<decltype(v)>>{}(v); }, key);
+    }
+};
+
+// Hash indexes answer exact-key gets in O(1); sorted indexes also answer "smallest key >= k".
+enum class IndexKind { Hash, Sorted };
+
+
+// Put/get request on an IndexedStore. Resumes with the item that was stored or retrieved.
+struct IndexedStoreEvent : SimEvent {
+    std::shared_ptr<ItemBase> item;
+
+    explicit IndexedStoreEvent(CSimpyEnv& env_, std::shared_ptr<ItemBase> it = nullptr)
+        : SimEvent(env_), item(std::move(it)) {}
+
+    struct Awaiter {
+        EventPtr<IndexedStoreEvent> self;
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int t) {
+                env->schedule_resume(t, proc, "IndexedStore::callback -> ");
+            });
+            auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
+            ht.promise().current_event = self.get();
+            return self->env.handoff();
+        }
+
+        auto await_resume() { return self->item; }
+    };
+
+    void on_succeed() override {
+        done = true;
+        this->sim_time = env.sim_time;
+        env.schedule(EventPtr<SimEventBase>(this));
+    }
+};
+
+inline IndexedStoreEvent::Awaiter operator co_await(EventPtr<IndexedStoreEvent> event) {
+    return IndexedStoreEvent::Awaiter{event};
+}
+
+
+// A Store whose items are additionally linked into user-declared indexes. Every item sits in an
+// insertion-order chain plus one chain per index (the items sharing its key), all threaded through
+// the item's slot, so removing an item is O(1) (plus O(log K) for sorted indexes) and never shifts
+// other items. Gets are served FIFO among the items that match.
+//
+//     IndexedStore staff(env, 5000, "staff");
+//     auto by_role = staff.add_index([](const ItemBase& i) {
+//         return IndexKey(static_cast<const StaffItem&>(i).role); });
+//     auto nurse = co_await staff.get_by(by_role, "Nurse");
+//
+// get(filter) is the linear fallback for requests no index covers.
+struct IndexedStore {
+    using Filter = std::function<bool(const std::shared_ptr<ItemBase>&)>;
+    using KeyExtractor = std::function<IndexKey(const ItemBase&)>;
+    using IndexId = size_t;
+
+    CSimpyEnv& env;
+    size_t capacity;
+    std::string name;
+    uint32_t trace_id;
+
+    IndexedStore(CSimpyEnv& e, size_t cap, std::string n = "")
+        : env(e), capacity(cap), name(std::move(n)), trace_id(e.next_resource_id()) {}
+
+    // Declares an index; items already in the store are indexed immediately.
+    IndexId add_index(KeyExtractor key, IndexKind kind = IndexKind::Hash) {
+        const IndexId id = indexes.size();
+        indexes.push_back(Index{std::move(key), kind, {}, {}});
+        for (Slot& slot : slots) slot.links.emplace_back();
+        for (uint32_t s = order.head; s != npos; s = slots[s].links[0].next) {
+            slots[s].keys.push_back(indexes[id].key(*slots[s].item));
+            link(chain_for(id, slots[s].keys[id]), s, id + 1);
+        }
+        return id;
+    }
+    static IndexId by_id() { return 0; }    // built in: ItemBase::id
+    static IndexId by_name() { return 1; }  // built in: ItemBase::name
+
+    EventPtr<IndexedStoreEvent> put(ItemBase& item) { return put(std::shared_ptr<ItemBase>(item.clone())); }
+    EventPtr<IndexedStoreEvent> put(std::shared_ptr<ItemBase> item) {
+        auto ev = env.make_event<IndexedStoreEvent>(env, std::move(item));
+        env.trace(TraceKind::StorePut, env.sim_time, ev->unique_id, env.current_process, trace_id);
+        put_waiters.push_back(ev);
+        admit_puts();
+        return ev;
+    }
+
+    // Oldest item.
+    EventPtr<IndexedStoreEvent> get() { return request(Request{Request::Any, 0, {}, {}}); }
+    // Oldest item whose key in `index` equals `key`.
+    EventPtr<IndexedStoreEvent> get_by(IndexId index, IndexKey key) {
+        return request(Request{Request::Equal, index, std::move(key), {}});
+    }
+    // Oldest item with the smallest key >= `key` in a sorted index.
+    EventPtr<IndexedStoreEvent> get_at_least(IndexId index, IndexKey key) {
+        assert(indexes[index].kind == IndexKind::Sorted);
+        return request(Request{Request::AtLeast, index, std::move(key), {}});
+    }
+    // Oldest item accepted by `filter`; a linear scan, for requests no index covers.
+    EventPtr<IndexedStoreEvent> get(Filter filter) { return request(Request{Request::Match, 0, {}, std::move(filter)}); }
+
+    size_t size() const { return count; }
+    size_t count_of(IndexId index, const IndexKey& key) const {
+        const Index& ix = indexes[index];
+        if (ix.kind == IndexKind::Hash) {
+            auto it = ix.hash.find(key);
+            return it == ix.hash.end() ? 0 : it->second.size;
+        }
+        auto it = ix.sorted.find(key);
+        return it == ix.sorted.end() ? 0 : it->second.size;
+    }
+
+private:
+    static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    struct Link { uint32_t prev = npos, next = npos; };
+    struct Chain { uint32_t head = npos, tail = npos; size_t size = 0; };
+    struct Slot {
+        std::shared_ptr<ItemBase> item;
+        std::vector<IndexKey> keys;  // one per index
+        std::vector<Link> links;     // [0] insertion order, [i + 1] chain of index i
+    };
+    struct Index {
+        KeyExtractor key;
+        IndexKind kind;
+        std::unordered_map<IndexKey, Chain, IndexKeyHash> hash;
+        std::map<IndexKey, Chain> sorted;
+    };
+    struct Request {
+        enum Kind { Any, Equal, AtLeast, Match } kind;
+        IndexId index;
+        IndexKey key;
+        Filter filter;
+    };
+    struct Waiter {
+        EventPtr<IndexedStoreEvent> event;
+        Request request;
+    };
+
+    std::vector<Index> indexes = {
+        Index{[](const ItemBase& i) { return IndexKey(static_cast<long long>(i.id)); }, IndexKind::Hash, {}, {}},
+        Index{[](const ItemBase& i) { return IndexKey(i.name); }, IndexKind::Hash, {}, {}},
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    Chain order;  // every stored item, oldest first
+    size_t count = 0;
+    // Invariant: no waiting getter matches a stored item, so only a newly stored item can satisfy
+    // one. Getters wait in arrival order and are matched against that one item.
+    std::list<Waiter> get_waiters;
+    std::list<EventPtr<IndexedStoreEvent>> put_waiters;
+
+    Chain& chain_for(IndexId index, const IndexKey& key) {
+        Index& ix = indexes[index];
+        return ix.kind == IndexKind::Hash ? ix.hash[key] : ix.sorted[key];
+    }
+
+    void link(Chain& chain, uint32_t s, size_t which) {
+        Link& l = slots[s].links[which];
+        l.prev = chain.tail;
+        l.next = npos;
+        if (chain.tail != npos) slots[chain.tail].links[which].next = s;
+        else chain.head = s;
+        chain.tail = s;
+        ++chain.size;
+    }
+
+    void unlink(Chain& chain, uint32_t s, size_t which) {
+        Link& l = slots[s].links[which];
+        if (l.prev != npos) slots[l.prev].links[which].next = l.next;
+        else chain.head = l.next;
+        if (l.next != npos) slots[l.next].links[which].prev = l.prev;
+        else chain.tail = l.prev;
+        --chain.size;
+    }
+
+    void insert(std::shared_ptr<ItemBase> item, std::vector<IndexKey> keys) {
+        uint32_t s;
+        if (!free_slots.empty()) {
+            s = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            s = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+            slots[s].links.resize(indexes.size() + 1);
+        }
+        slots[s].item = std::move(item);
+        slots[s].keys = std::move(keys);
+        link(order, s, 0);
+        for (IndexId i = 0; i < indexes.size(); ++i) link(chain_for(i, slots[s].keys[i]), s, i + 1);
+        ++count;
+    }
+
+    std::shared_ptr<ItemBase> remove(uint32_t s) {
+        unlink(order, s, 0);
+        for (IndexId i = 0; i < indexes.size(); ++i) {
+            Index& ix = indexes[i];
+            const IndexKey& key = slots[s].keys[i];
+            if (ix.kind == IndexKind::Hash) {
+                auto it = ix.hash.find(key);
+                unlink(it->second, s, i + 1);
+                if (it->second.size == 0) ix.hash.erase(it);
+            } else {
+                auto it = ix.sorted.find(key);
+                unlink(it->second, s, i + 1);
+                if (it->second.size == 0) ix.sorted.erase(it);
+            }
+        }
+        --count;
+        free_slots.push_back(s);
+        slots[s].keys.clear();
+        return std::move(slots[s].item);
+    }
+
+    // Slot of the oldest stored item satisfying the request, or npos.
+    uint32_t find(const Request& r) {
+        switch (r.kind) {
+            case Request::Any:
+                return order.head;
+            case Request::Equal: {
+                const Index& ix = indexes[r.index];
+                if (ix.kind == IndexKind::Hash) {
+                    auto it = ix.hash.find(r.key);
+                    return it == ix.hash.end() ? npos : it->second.head;
+                }
+                auto it = ix.sorted.find(r.key);
+                return it == ix.sorted.end() ? npos : it->second.head;
+            }
+            case Request::AtLeast: {
+                const Index& ix = indexes[r.index];
+                auto it = ix.sorted.lower_bound(r.key);
+                return it == ix.sorted.end() ? npos : it->second.head;
+            }
+            case Request::Match:
+                for (uint32_t s = order.head; s != npos; s = slots[s].links[0].next) {
+                    if (!r.filter || r.filter(slots[s].item)) return s;
+                }
+                return npos;
+        }
+        return npos;
+    }
+
+    bool matches(const Request& r, const std::shared_ptr<ItemBase>& item, const std::vector<IndexKey>& keys) const {
+        switch (r.kind) {
+            case Request::Any: return true;
+            case Request::Equal: return keys[r.index] == r.key;
+            case Request::AtLeast: return !(keys[r.index] < r.key);
+            case Request::Match: return !r.filter || r.filter(item);
+        }
+        return false;
+    }
+
+    EventPtr<IndexedStoreEvent> request(Request r) {
+        auto ev = env.make_event<IndexedStoreEvent>(env);
+        env.trace(TraceKind::StoreGet, env.sim_time, ev->unique_id, env.current_process, trace_id);
+        const uint32_t s = find(r);
+        if (s == npos) {
+            get_waiters.push_back(Waiter{ev, std::move(r)});
+            return ev;
+        }
+        ev->item = remove(s);
+        ev->on_succeed();
+        admit_puts();  // the freed space may let a blocked putter in
+        return ev;
+    }
+
+    // Stores waiting items while there is room; each one goes straight to the first getter it
+    // satisfies instead of into the indexes.
+    void admit_puts() {
+        while (!put_waiters.empty()) {
+            auto& put_event = put_waiters.front();
+            std::vector<IndexKey> keys;
+            keys.reserve(indexes.size());
+            for (const Index& ix : indexes) keys.push_back(ix.key(*put_event->item));
+
+            auto waiter = std::find_if(get_waiters.begin(), get_waiters.end(), [&](const Waiter& w) {
+                return matches(w.request, put_event->item, keys);
+            });
+            if (waiter != get_waiters.end()) {
+                waiter->event->item = put_event->item;
+                waiter->event->on_succeed();
+                get_waiters.erase(waiter);
+            } else if (count < capacity) {
+                insert(put_event->item, std::move(keys));
+            } else {
+                return;
+            }
+            put_event->on_succeed();
+            put_waiters.pop_front();
+        }
+    }
+};
+
+#endif //INDEXED_STORE_H
@@ -0,0 +1,82 @@
+//
+// Vector with inline storage for the first N elements; spills to the heap beyond that.
+//
+
+#ifndef INLINE_VECTOR_H
+#define INLINE_VECTOR_H
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+// Small-size-optimised vector for per-event bookkeeping (condition children and results), which
+// is a handful of entries in nearly every model. Not copyable or movable: it lives inside events.
+template<typename T, size_t N>
+class InlineVector {
+public:
+    InlineVector() = default;
+    InlineVector(std::initializer_list<T> init) {
+        reserve(init.size());
+        for (const T& v : init) push_back(v);
+    }
+    InlineVector(const InlineVector&) = delete;
+    InlineVector& operator=(const InlineVector&) = delete;
+
+    ~InlineVector() {
+        clear();
+        if (heap) std::allocator<T>().deallocate(heap, cap);
+    }
+
+    void reserve(size_t n) {
+        if (n <= cap) return;
+        T* bigger = std::allocator<T>().allocate(n);
+        T* old = data();
+        for (size_t i = 0; i < count; ++i) {
+            new (bigger + i) T(std::move(old[i]));
+            old[i].~T();
+        }
+        if (heap) std::allocator<T>().deallocate(heap, cap);
+        heap = bigger;
+        cap = n;
+    }
+
+    void push_back(T value) {
+        if (count == cap) reserve(cap * 2);
+        new (data() + count) T(std::move(value));
+        ++count;
+    }
+
+    // Grows to n default-constructed elements (never shrinks).
+    void resize(size_t n) {
+        reserve(n);
+        for (; count < n; ++count) new (data() + count) T();
+    }
+
+    void clear() {
+        T* p = data();
+        for (size_t i = 0; i < count; ++i) p[i].~T();
+        count = 0;
+    }
+
+    T* data() { return heap ? heap : std::launder(reinterpret_cast<T*>(local)); }
+    const T* data() const { return heap ? heap : std::launder(reinterpret_cast<const T*>(local)); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    T* begin() { return data(); }
+    T* end() { return data() + count; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + count; }
+    std::span<const T> span() const { return {data(), count}; }
+
+private:
+    alignas(T) unsigned char local[N * sizeof(T)];
+    T* heap = nullptr;
+    size_t count = 0;
+    size_t cap = N;
+};
+
+#endif //INLINE_VECTOR_H
@@ -0,0 +1,139 @@
+//
+// Runs independent replications of a model on a work-stealing thread pool.
+//
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "csimpy_env.h"
+
+// Fixed set of workers, each with its own deque of task indices. A worker pops from the back of
+// its own deque and, once that is empty, steals from the front of the others.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads)
+        : num_threads(std::max<size_t>(1, threads)) {}
+
+    // Calls task(i) for every i in [0, n_tasks) and blocks until all of them finished.
+    // The first exception thrown by a task is rethrown here after the workers are joined.
+    void run(size_t n_tasks, const std::function<void(size_t)>& task) {
+        const size_t workers = std::min(num_threads, std::max<size_t>(1, n_tasks));
+        std::vector<Queue> queues(workers);
+        for (size_t i = 0; i < n_tasks; ++i) {
+            queues[i * workers / n_tasks].tasks.push_back(i);  // contiguous chunk per worker
+        }
+
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        std::atomic<bool> failed{false};
+        auto worker = [&](size_t self) {
+            while (!failed.load(std::memory_order_relaxed)) {
+                std::optional<size_t> next = pop_back(queues[self]);
+                for (size_t k = 1; !next && k < workers; ++k) {
+                    next = steal_front(queues[(self + k) % workers]);
+                }
+                if (!next) return;  // nothing left anywhere; tasks never enqueue new tasks
+                try {
+                    task(*next);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (size_t w = 1; w < workers; ++w) threads.emplace_back(worker, w);
+        worker(0);  // the calling thread works too
+        for (auto& t : threads) t.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+    size_t size() const { return num_threads; }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    static std::optional<size_t> pop_back(Queue& q) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return std::nullopt;
+        size_t i = q.tasks.back();
+        q.tasks.pop_back();
+        return i;
+    }
+    static std::optional<size_t> steal_front(Queue& q) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return std::nullopt;
+        size_t i = q.tasks.front();
+        q.tasks.pop_front();
+        return i;
+    }
+
+    size_t num_threads;
+};
+
+
+// Runs N replications of a model, each in its own CSimpyEnv. Replication i always gets the same
+// seed (derived from base_seed and i), and results are reduced in replication order, so the
+// outcome is identical to a serial run no matter how many threads are used or who ran what.
+template<typename Result>
+class ReplicationRunner {
+public:
+    // Builds the model in env, runs it, and returns its result. env.rng is already seeded.
+    using Model = std::function<Result(CSimpyEnv& env, size_t replication)>;
+
+    explicit ReplicationRunner(size_t threads = std::thread::hardware_concurrency(),
+                               QueueKind kind = QueueKind::QuadHeap)
+        : pool(threads), queue_kind(kind) {}
+
+    // Seed of replication i: a splitmix64 step, so neighbouring streams are decorrelated.
+    static uint64_t replication_seed(uint64_t base_seed, size_t replication) {
+        uint64_t z = base_seed + 0x9E3779B97F4A7C15ULL * (static_cast<uint64_t>(replication) + 1);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Runs every replication and returns them in replication order.
+    std::vector<Result> run(size_t replications, uint64_t base_seed, const Model& model) {
+        std::vector<std::optional<Result>> slots(replications);
+        pool.run(replications, [&](size_t i) {
+            CSimpyEnv env(queue_kind, replication_seed(base_seed, i));
+            slots[i].emplace(model(env, i));
+        });
+        std::vector<Result> results;
+        results.reserve(replications);
+        for (auto& slot : slots) results.push_back(std::move(*slot));
+        return results;
+    }
+
+    // Runs every replication and folds the results with reduce(acc, result) in replication order.
+    template<typename Acc, typename Reduce>
+    Acc run(size_t replications, uint64_t base_seed, const Model& model, Acc init, Reduce reduce) {
+        Acc acc = std::move(init);
+        for (auto& result : run(replications, base_seed, model)) {
+            acc = reduce(std::move(acc), std::move(result));
+        }
+        return acc;
+    }
+
+private:
+    WorkStealingPool pool;
+    QueueKind queue_kind;
+};
+
+#endif //REPLICATION_H
@@ -0,0 +1,293 @@
+//
+// Resource, PriorityResource and PreemptiveResource: servers with a fixed number of units, each
+// held by one user through an RAII token.
+//
+
+#ifndef RESOURCE_H
+#define RESOURCE_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "csimpy_env.h"
+
+struct Resource;
+
+// Interrupt cause delivered to a holder whose unit a PreemptiveResource gave to a more urgent
+// request.
+struct Preempted : ItemBase {
+    Resource* resource;
+    Priority by_priority;  // priority of the request that took the unit
+    int usage_since;       // when the preempted holder was granted the unit
+
+    Preempted(Resource* r, Priority by, int since)
+        : ItemBase("preempted", 0), resource(r), by_priority(by), usage_since(since) {}
+
+    ItemBase* clone() const override {
+        return new Preempted(*this);
+    }
+};
+
+// One unit of a Resource. Releasing it - release(), assignment or destruction - hands the unit
+// straight to the next waiter; no event is queued for the release itself. A token whose unit
+// was preempted no longer holds anything and releases nothing. Must not outlive its resource.
+class ResourceToken {
+public:
+    ResourceToken() = default;
+    ResourceToken(Resource& r, uint32_t s, uint32_t gen) : resource(&r), slot(s), generation(gen) {}
+
+    ResourceToken(ResourceToken&& other) noexcept
+        : resource(std::exchange(other.resource, nullptr)), slot(other.slot), generation(other.generation) {}
+    ResourceToken& operator=(ResourceToken&& other) noexcept {
+        if (this != &other) {
+            release();
+            resource = std::exchange(other.resource, nullptr);
+            slot = other.slot;
+            generation = other.generation;
+        }
+        return *this;
+    }
+    ResourceToken(const ResourceToken&) = delete;
+    ResourceToken& operator=(const ResourceToken&) = delete;
+    ~ResourceToken() { release(); }
+
+    bool held() const;
+    explicit operator bool() const { return held(); }
+    void release();
+
+private:
+    Resource* resource = nullptr;
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+};
+
+// Request for one unit of a Resource; co_await yields its ResourceToken. While it waits it can be
+// withdrawn, interrupted or given a deadline with expire_after() like any ResourceRequest; a
+// timed-out request yields an empty token.
+struct ResourceClaim : ResourceRequest {
+    static constexpr uint32_t no_slot = UINT32_MAX;
+
+    Resource& resource;
+    Priority priority;
+    PriorityWaiters<ResourceClaim>::Position position;  // valid while waiting
+    uint32_t slot = no_slot;  // unit granted to this request, until co_await takes the token
+    uint32_t generation = 0;
+    ProcessHandle requester;  // known once the requester awaits the request
+
+    ResourceClaim(CSimpyEnv& env_, Resource& r, Priority prio)
+        : ResourceRequest(env_), resource(r), priority(prio) {}
+    // A unit granted to a request nobody awaited goes back to the resource.
+    ~ResourceClaim() override { ResourceToken unclaimed = take_token(); }
+
+    struct Awaiter {
+        EventPtr<ResourceClaim> self;
+
+        // Always suspends, even for an immediate grant, so the holder's process is recorded
+        // for preemption; an immediate grant then resumes straight away.
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h);
+        [[nodiscard]] ResourceToken await_resume();
+    };
+
+    ResourceToken take_token() {
+        if (slot == no_slot) return {};
+        return ResourceToken(resource, std::exchange(slot, no_slot), generation);
+    }
+
+    void on_succeed() override {
+        done = true;
+        sim_time = env.sim_time;
+        env.schedule(EventPtr<SimEventBase>(this));
+    }
+
+protected:
+    void remove_waiter() override;
+};
+
+inline ResourceClaim::Awaiter operator co_await(EventPtr<ResourceClaim> event) {
+    return ResourceClaim::Awaiter{event};
+}
+
+// Server with `capacity` identical units, granted one per request in arrival order. Unlike a
+// Container used as a unit counter, the holders are known: a unit comes back when its token is
+// released, with no put event, and PreemptiveResource can take it from a lower-priority holder.
+//
+//     Resource bays(env, 2, "bays");
+//     {
+//         ResourceToken bay = co_await bays.request();
+//         co_await SimDelay(env, 5);
+//     }   // released here
+struct Resource {
+    CSimpyEnv& env;
+    int capacity;
+    std::string name;
+    uint32_t trace_id;
+
+    Resource(CSimpyEnv& e, int cap, std::string n = "")
+        : env(e), capacity(cap), name(std::move(n)), trace_id(e.next_resource_id()), holders(cap) {
+        free_units.reserve(cap);
+        for (int unit = cap - 1; unit >= 0; --unit) free_units.push_back(static_cast<uint32_t>(unit));
+    }
+    Resource(const Resource&) = delete;
+    Resource& operator=(const Resource&) = delete;
+
+    EventPtr<ResourceClaim> request() { return claim(Priority::Low, false); }
+
+    int count() const { return capacity - static_cast<int>(free_units.size()); }  // units in use
+    size_t queue_length() const { return waiters.size(); }
+
+protected:
+    // Queues a request, preempting a lower-priority holder first if asked to and no unit is free.
+    EventPtr<ResourceClaim> claim(Priority priority, bool preempt);
+
+private:
+    friend class ResourceToken;
+    friend struct ResourceClaim;
+
+    struct Holder {
+        ProcessHandle process;
+        Priority priority = Priority::Low;
+        int since = 0;
+        size_t order = 0;         // id of the granted request; the latest one is preempted first
+        uint32_t generation = 0;  // bumped when the unit is released, so stale tokens stop matching
+        bool busy = false;
+    };
+
+    std::vector<Holder> holders;  // one per unit
+    std::vector<uint32_t> free_units;
+    // Only non-empty while every unit is busy.
+    PriorityWaiters<ResourceClaim> waiters;
+
+    bool holds(uint32_t slot, uint32_t generation) const {
+        return holders[slot].busy && holders[slot].generation == generation;
+    }
+
+    void grant(ResourceClaim& request) {
+        const uint32_t slot = free_units.back();
+        free_units.pop_back();
+        Holder& holder = holders[slot];
+        holder.busy = true;
+        holder.process = request.requester;
+        holder.priority = request.priority;
+        holder.since = env.sim_time;
+        holder.order = request.unique_id;
+        request.slot = slot;
+        request.generation = holder.generation;
+        request.served();
+    }
+
+    void vacate(uint32_t slot) {
+        Holder& holder = holders[slot];
+        holder.busy = false;
+        holder.process = {};
+        ++holder.generation;
+        free_units.push_back(slot);
+        env.trace(TraceKind::ResourceRelease, env.sim_time, 0, env.current_process, trace_id);
+    }
+
+    void release(uint32_t slot, uint32_t generation) {
+        if (!holds(slot, generation)) return;
+        vacate(slot);
+        trigger();
+    }
+
+    void trigger() {
+        using Action = PriorityWaiters<ResourceClaim>::Action;
+        waiters.service([this](const EventPtr<ResourceClaim>& request) {
+            if (free_units.empty()) return Action::Stop;
+            grant(*request);
+            request->on_succeed();
+            return Action::Serve;
+        });
+    }
+
+    // Frees the unit of the lowest-priority holder below `priority` (the most recently granted
+    // among equals) and interrupts that holder. Scans the units, so O(capacity).
+    void preempt_below(Priority priority) {
+        uint32_t victim = ResourceClaim::no_slot;
+        for (uint32_t slot = 0; slot < holders.size(); ++slot) {
+            const Holder& holder = holders[slot];
+            if (!holder.busy || !(holder.priority < priority)) continue;
+            if (victim == ResourceClaim::no_slot || holder.priority < holders[victim].priority
+                || (holder.priority == holders[victim].priority && holder.order > holders[victim].order)) {
+                victim = slot;
+            }
+        }
+        if (victim == ResourceClaim::no_slot) return;
+        const ProcessHandle process = holders[victim].process;
+        const int since = holders[victim].since;
+        vacate(victim);
+        process.interrupt(std::make_shared<Preempted>(this, priority, since));
+    }
+};
+
+// Resource whose waiters are served highest priority first, equal priorities in arrival order
+// (the Priority convention of Store; SimPy's PriorityResource serves the lowest number first).
+struct PriorityResource : Resource {
+    using Resource::Resource;
+
+    EventPtr<ResourceClaim> request(Priority priority = Priority::Low) { return claim(priority, false); }
+};
+
+// PriorityResource that, when every unit is busy, takes one from the lowest-priority holder
+// below the new request's priority. That holder is interrupted with a Preempted cause and its
+// token stops holding anything. preempt = false queues the request without preempting.
+struct PreemptiveResource : PriorityResource {
+    using PriorityResource::PriorityResource;
+
+    EventPtr<ResourceClaim> request(Priority priority = Priority::Low, bool preempt = true) {
+        return claim(priority, preempt);
+    }
+};
+
+inline bool ResourceToken::held() const {
+    return resource && resource->holds(slot, generation);
+}
+
+inline void ResourceToken::release() {
+    if (Resource* r = std::exchange(resource, nullptr)) r->release(slot, generation);
+}
+
+inline void ResourceClaim::remove_waiter() {
+    resource.waiters.erase(position);
+}
+
+inline std::coroutine_handle<> ResourceClaim::Awaiter::await_suspend(std::coroutine_handle<> h) {
+    self->requester = process_of(h);
+    if (self->slot != no_slot) self->resource.holders[self->slot].process = self->requester;
+    if (self->immediate) return h;
+    self->callbacks.add([env = &self->env, proc = self->requester](int t) {
+        env->schedule_resume(t, proc, "ResourceClaim::callback -> ");
+    });
+    auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
+    ht.promise().current_event = self.get();
+    return self->env.handoff();
+}
+
+inline ResourceToken ResourceClaim::Awaiter::await_resume() {
+    // Taken first, so a unit granted just before an interrupt is released by the throw.
+    ResourceToken token = self->take_token();
+    self->throw_if_interrupted();
+    return token;
+}
+
+inline EventPtr<ResourceClaim> Resource::claim(Priority priority, bool preempt) {
+    auto ev = env.make_event<ResourceClaim>(env, *this, priority);
+    env.trace(TraceKind::ResourceRequest, env.sim_time, ev->unique_id, env.current_process, trace_id);
+    if (!free_units.empty()) {
+        grant(*ev);
+        if (env.immediate_requests) ev->done = ev->immediate = true;
+        else ev->on_succeed();
+        return ev;
+    }
+    ev->waiting = true;
+    ev->position = waiters.push(priority, ev);
+    if (preempt) {
+        preempt_below(priority);
+        trigger();
+    }
+    return ev;
+}
+
+#endif //RESOURCE_H
@@ -0,0 +1,136 @@
+//
+// Binary event trace: fixed-size records in a ring buffer, written to a file by a background thread.
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class TraceKind : uint8_t {
+    Schedule = 0,      // an event was queued; sim_time is the time it is due
+    Resume = 1,        // a process was resumed
+    ContainerPut = 2,  // put request on a Container
+    ContainerGet = 3,  // get request on a Container
+    StorePut = 4,      // put request on a Store / IndexedStore
+    StoreGet = 5,      // get request on a Store / IndexedStore
+    Interrupt = 6,     // a process was interrupted (process = the target)
+    TaskDone = 7,      // a process ran to completion
+    ResourceRequest = 8,  // request for a unit of a Resource
+    ResourceRelease = 9,  // a Resource unit was released or preempted
+};
+
+inline const char* to_string(TraceKind kind) {
+    switch (kind) {
+        case TraceKind::Schedule: return "schedule";
+        case TraceKind::Resume: return "resume";
+        case TraceKind::ContainerPut: return "container_put";
+        case TraceKind::ContainerGet: return "container_get";
+        case TraceKind::StorePut: return "store_put";
+        case TraceKind::StoreGet: return "store_get";
+        case TraceKind::Interrupt: return "interrupt";
+        case TraceKind::TaskDone: return "task_done";
+        case TraceKind::ResourceRequest: return "resource_request";
+        case TraceKind::ResourceRelease: return "resource_release";
+    }
+    return "unknown";
+}
+
+// On-disk record. process and resource are 0 when not applicable; seq is the event's unique_id.
+struct TraceRecord {
+    int32_t sim_time;
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint64_t seq;
+    uint32_t process;
+    uint32_t resource;
+};
+static_assert(sizeof(TraceRecord) == 24, "trace records are a fixed 24 bytes on disk");
+
+// File header: magic, then the format version and record size so the decoder can validate.
+struct TraceFileHeader {
+    char magic[8] = {'C', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+    uint32_t version = 1;
+    uint32_t record_size = sizeof(TraceRecord);
+};
+
+
+// Single-producer ring buffer drained to a file by its own thread. The simulation thread only
+// copies a record and bumps an index; when the ring is full it waits for the writer to catch up,
+// so no record is ever dropped.
+class TraceWriter {
+public:
+    // ring_records is rounded up to a power of two.
+    explicit TraceWriter(const std::string& path, size_t ring_records = size_t{1} << 16) {
+        size_t capacity = 1;
+        while (capacity < ring_records) capacity <<= 1;
+        ring.resize(capacity);
+        mask = capacity - 1;
+
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot open trace file: " + path);
+        TraceFileHeader header;
+        std::fwrite(&header, sizeof(header), 1, file);
+        writer = std::thread([this] { drain_loop(); });
+    }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // Flushes everything recorded so far and closes the file.
+    ~TraceWriter() {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+        std::fclose(file);
+    }
+
+    void record(TraceKind kind, int sim_time, uint64_t seq, uint32_t process, uint32_t resource) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        while (h - tail.load(std::memory_order_acquire) == ring.size()) {
+            std::this_thread::yield();
+        }
+        ring[h & mask] = TraceRecord{sim_time, static_cast<uint8_t>(kind), {}, seq, process, resource};
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    uint64_t records() const { return head.load(std::memory_order_relaxed); }
+
+private:
+    void drain_loop() {
+        while (true) {
+            const size_t h = head.load(std::memory_order_acquire);
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (h == t) {
+                if (stopping.load(std::memory_order_acquire) && h == head.load(std::memory_order_acquire)) break;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            while (t != h) {
+                // Write up to the end of the ring (or the head) in one call.
+                const size_t begin = t & mask;
+                const size_t n = std::min(h - t, ring.size() - begin);
+                std::fwrite(&ring[begin], sizeof(TraceRecord), n, file);
+                t += n;
+            }
+            tail.store(t, std::memory_order_release);
+        }
+        std::fflush(file);
+    }
+
+    std::vector<TraceRecord> ring;
+    size_t mask = 0;
+    std::atomic<size_t> head{0};  // next slot the simulation writes
+    std::atomic<size_t> tail{0};  // next slot the writer thread reads
+    std::atomic<bool> stopping{false};
+    std::FILE* file = nullptr;
+    std::thread writer;
+};
+
+#endif //TRACE_H
@@ -0,0 +1,198 @@
+//
+// Store of plain values: items are kept by value in a ring buffer and moved in and out.
+//
+
+#ifndef TYPED_STORE_H
+#define TYPED_STORE_H
+#include <functional>
+#include <optional>
+#include <string>
+#include "csimpy_env.h"
+
+template<typename T>
+struct TypedStore;
+
+// Put request on a TypedStore; owns the item until the store accepts it.
+template<typename T>
+struct TypedStorePutEvent : SimEvent {
+    TypedStore<T>& store;
+    T item;
+    Priority priority;
+
+    TypedStorePutEvent(CSimpyEnv& env_, TypedStore<T>& s, T it, Priority prio = Priority::Low)
+        : SimEvent(env_), store(s), item(std::move(it)), priority(prio) {
+        sim_time = env.sim_time;
+    }
+
+    struct Awaiter {
+        EventPtr<TypedStorePutEvent> self;
+
+        bool await_ready() const noexcept { return self->immediate; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int t) {
+                env->schedule_resume(t, proc, "TypedStorePut::callback -> ");
+            });
+            auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
+            ht.promise().current_event = self.get();
+            return self->env.handoff();
+        }
+
+        void await_resume() {}
+    };
+
+    void on_succeed() override {
+        done = true;
+        this->sim_time = env.sim_time;
+        env.schedule(EventPtr<SimEventBase>(this));
+    }
+};
+
+// Get request on a TypedStore; co_await yields the item by value.
+template<typename T>
+struct TypedStoreGetEvent : SimEvent {
+    using Filter = std::function<bool(const T&)>;
+
+    TypedStore<T>& store;
+    Filter filter;
+    Priority priority;
+    std::optional<T> item;
+
+    TypedStoreGetEvent(CSimpyEnv& env_, TypedStore<T>& s, Filter f = {}, Priority prio = Priority::Low)
+        : SimEvent(env_), store(s), filter(std::move(f)), priority(prio) {
+        sim_time = env.sim_time;
+    }
+
+    struct Awaiter {
+        EventPtr<TypedStoreGetEvent> self;
+
+        bool await_ready() const noexcept { return self->immediate; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) {
+            self->callbacks.add([env = &self->env, proc = process_of(h)](int t) {
+                env->schedule_resume(t, proc, "TypedStoreGet::callback -> ");
+            });
+            auto ht = std::coroutine_handle<TaskPromise>::from_address(h.address());
+            ht.promise().current_event = self.get();
+            return self->env.handoff();
+        }
+
+        T await_resume() { return std::move(*self->item); }
+    };
+
+    void on_succeed() override {
+        done = true;
+        this->sim_time = env.sim_time;
+        env.schedule(EventPtr<SimEventBase>(this));
+    }
+};
+
+template<typename T>
+typename TypedStorePutEvent<T>::Awaiter operator co_await(EventPtr<TypedStorePutEvent<T>> event) {
+    return typename TypedStorePutEvent<T>::Awaiter{event};
+}
+
+template<typename T>
+typename TypedStoreGetEvent<T>::Awaiter operator co_await(EventPtr<TypedStoreGetEvent<T>> event) {
+    return typename TypedStoreGetEvent<T>::Awaiter{event};
+}
+
+
+// Store holding values of one type instead of shared_ptr<ItemBase>. Items are moved into a
+// contiguous ring buffer on put and moved out to the getter, so a handoff costs no item
+// allocation, no clone() and no shared_ptr traffic. Waiting, priorities and filtered gets work as
+// in Store. T must be default-constructible and movable.
+//
+//     TypedStore<Job> jobs(env, 100, "jobs");
+//     co_await jobs.put(Job{42, 3});
+//     Job job = co_await jobs.get();
+template<typename T>
+struct TypedStore {
+    using Filter = typename TypedStoreGetEvent<T>::Filter;
+
+    CSimpyEnv& env;
+    size_t capacity;
+    std::string name;
+    uint32_t trace_id;
+
+    TypedStore(CSimpyEnv& e, size_t cap, std::string n = "")
+        : env(e), capacity(cap), name(std::move(n)), trace_id(e.next_resource_id()) {}
+
+    EventPtr<TypedStorePutEvent<T>> put(T item, Priority priority = Priority::Low) {
+        auto ev = env.make_event<TypedStorePutEvent<T>>(env, *this, std::move(item), priority);
+        env.trace(TraceKind::StorePut, env.sim_time, ev->unique_id, env.current_process, trace_id);
+        if (env.immediate_requests && put_waiters.empty() && can_put()) {
+            items.push_back(std::move(ev->item));
+            ev->done = ev->immediate = true;
+            trigger_get();
+            return ev;
+        }
+        put_waiters.push(priority, ev);
+        ev->callbacks.add([this](int) { trigger_get(); });
+        trigger_put();
+        return ev;
+    }
+
+    // Oldest item.
+    EventPtr<TypedStoreGetEvent<T>> get(Priority priority = Priority::Low) { return get(Filter{}, priority); }
+    // Oldest item accepted by filter.
+    EventPtr<TypedStoreGetEvent<T>> get(Filter filter, Priority priority = Priority::Low) {
+        auto ev = env.make_event<TypedStoreGetEvent<T>>(env, *this, std::move(filter), priority);
+        env.trace(TraceKind::StoreGet, env.sim_time, ev->unique_id, env.current_process, trace_id);
+        if (env.immediate_requests && get_waiters.empty()) {
+            if (const size_t i = find(ev->filter); i < items.size()) {
+                ev->item.emplace(items.take(i));
+                ev->done = ev->immediate = true;
+                trigger_put();
+                return ev;
+            }
+        }
+        get_waiters.push(priority, ev);
+        ev->callbacks.add([this](int) { trigger_put(); });
+        trigger_get();
+        return ev;
+    }
+
+    size_t size() const { return items.size(); }
+    bool can_put() const { return items.size() < capacity; }
+    bool can_get() const { return !items.empty(); }
+
+private:
+    FifoRing<T> items;
+    PriorityWaiters<TypedStoreGetEvent<T>> get_waiters;
+    PriorityWaiters<TypedStorePutEvent<T>> put_waiters;
+
+    // Position of the oldest item the filter accepts, or size() if there is none.
+    size_t find(const Filter& filter) {
+        size_t i = 0;
+        if (filter) {
+            while (i < items.size() && !filter(items[i])) ++i;
+        }
+        return i;
+    }
+
+    void trigger_put() {
+        using Action = typename PriorityWaiters<TypedStorePutEvent<T>>::Action;
+        put_waiters.service([this](const EventPtr<TypedStorePutEvent<T>>& evt) {
+            if (!can_put()) return Action::Stop;
+            items.push_back(std::move(evt->item));
+            evt->on_succeed();
+            return Action::Serve;
+        });
+    }
+
+    void trigger_get() {
+        using Action = typename PriorityWaiters<TypedStoreGetEvent<T>>::Action;
+        // Filtered getters that match nothing are skipped, so later waiters can still be served.
+        get_waiters.service([this](const EventPtr<TypedStoreGetEvent<T>>& evt) {
+            if (items.empty()) return Action::Stop;
+            const size_t i = find(evt->filter);
+            if (i == items.size()) return Action::Skip;
+            evt->item.emplace(items.take(i));
+            evt->on_succeed();
+            return Action::Serve;
+        });
+    }
+};
+
+#endif //TYPED_STORE_H
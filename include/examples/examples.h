@@ -9,6 +9,7 @@ void example_6();
 void example_7();
 void example_8() ;
 void example_patient_flow();
+void example_indexed_store();
 void example_priority_store();
 void example_carwash_with_container();
 void example_gas_station();
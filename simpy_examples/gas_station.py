@@ -36,7 +36,7 @@ def car(name, env, pumps, fuel_tank):
 
 
 def fuel_monitor(env, fuel_tank):
-    while env.now <= MAX_TIME:
+    while True:
         yield env.timeout(CHECK_INTERVAL)
         if fuel_tank.level < LOW_THRESHOLD:
             print(f"[{env.now}] Fuel low (level={fuel_tank.level}), scheduling truck in {REFUEL_TRUCK_DELAY}")
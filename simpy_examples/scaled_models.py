@@ -0,0 +1,136 @@
+"""
+Scaled, output-free versions of the carwash, gas station and patient flow examples.
+
+Each model mirrors its C++ counterpart in bench/macro_bench.cpp step for step: same resources
+(Containers used as token pools, as in the C++ examples), same deterministic arrival and service
+patterns. Prints one JSON object per run.
+
+Usage: python -m simpy_examples.scaled_models <carwash|gas_station|patient_flow> <entities>
+"""
+import json
+import sys
+import time
+
+import simpy
+
+
+class CountingEnvironment(simpy.Environment):
+    """Environment that counts processed events, for events/second comparisons."""
+
+    def __init__(self):
+        super().__init__()
+        self.events_processed = 0
+
+    def step(self):
+        self.events_processed += 1
+        super().step()
+
+
+# Deterministic stand-ins for random draws, identical in the C++ models.
+def inter_arrival(i):
+    return 1 + i % 3  # mean 2
+
+
+def spread(i, base, mul):
+    return base + i * mul % 11  # base + 0..10
+
+
+def token_pool(env, size):
+    return simpy.Container(env, size, init=size)
+
+
+def carwash(env, n):
+    machines = token_pool(env, 6)
+
+    def car(i):
+        yield machines.get(1)
+        yield env.timeout(spread(i, 5, 7))
+        yield machines.put(1)
+
+    def arrivals():
+        for i in range(n):
+            env.process(car(i))
+            yield env.timeout(inter_arrival(i))
+
+    env.process(arrivals())
+    env.run()
+
+
+def gas_station(env, n):
+    pumps = token_pool(env, 8)
+    fuel_tank = token_pool(env, 2000)
+    state = {"cars_left": n, "truck_pending": False}
+
+    def car(i):
+        yield pumps.get(1)
+        yield fuel_tank.get(spread(i, 5, 3))
+        yield env.timeout(3)
+        yield pumps.put(1)
+        state["cars_left"] -= 1
+
+    def truck():
+        yield env.timeout(30)
+        yield fuel_tank.put(fuel_tank.capacity - fuel_tank.level)
+        state["truck_pending"] = False
+
+    def monitor():
+        while state["cars_left"] > 0:
+            yield env.timeout(10)
+            if not state["truck_pending"] and fuel_tank.level < 500:
+                state["truck_pending"] = True
+                env.process(truck())
+
+    def arrivals():
+        for i in range(n):
+            env.process(car(i))
+            yield env.timeout(inter_arrival(i))
+
+    env.process(monitor())
+    env.process(arrivals())
+    env.run()
+
+
+def patient_flow(env, n):
+    desks = token_pool(env, 2)
+    doctors = token_pool(env, 12)
+    labs = token_pool(env, 24)
+
+    def visit(staff, duration):
+        yield staff.get(1)
+        yield env.timeout(duration)
+        yield staff.put(1)
+
+    def patient(i):
+        yield desks.get(1)
+        yield env.timeout(3)
+        yield desks.put(1)
+        doctor = env.process(visit(doctors, spread(i, 15, 7)))
+        lab = env.process(visit(labs, spread(i, 35, 5)))
+        yield env.all_of([doctor, lab])
+
+    def arrivals():
+        for i in range(n):
+            env.process(patient(i))
+            yield env.timeout(inter_arrival(i))
+
+    env.process(arrivals())
+    env.run()
+
+
+MODELS = {"carwash": carwash, "gas_station": gas_station, "patient_flow": patient_flow}
+
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in MODELS:
+        sys.exit(f"usage: {sys.argv[0]} <{'|'.join(MODELS)}> <entities>")
+    model, n = sys.argv[1], int(sys.argv[2])
+    env = CountingEnvironment()
+    start = time.perf_counter()
+    MODELS[model](env, n)
+    seconds = time.perf_counter() - start
+    print(json.dumps({"engine": "simpy", "model": model, "entities": n, "events": env.events_processed,
+                      "sim_time": env.now, "seconds": round(seconds, 6)}))
+
+
+if __name__ == "__main__":
+    main()
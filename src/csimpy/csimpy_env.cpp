@@ -1,55 +1,216 @@
 #include "../../include/csimpy/csimpy_env.h"
 #include <iostream>
 
-void CSimpyEnv::schedule(std::shared_ptr<SimEventBase> ev) {
-    event_queue.push(std::move(ev));
+void CSimpyEnv::schedule(EventPtr<SimEventBase> ev) {
+    const EventKey key{ev->sim_time, ev->unique_id};
+    trace(TraceKind::Schedule, key.time, key.seq, current_process);
+    enqueue(key, std::move(ev));
 }
 
-void CSimpyEnv::schedule(std::shared_ptr<Task> t, const std::string& label) {
-    auto proc = std::make_shared<CoroutineProcess>(this->sim_time, t->h, label);
-    schedule(proc);
+void CSimpyEnv::enqueue(EventKey key, EventPtr<SimEventBase> ev) {
+    ++ev->queued;
+    if (key.time == sim_time && (now_queue.empty() || now_queue.back().key.seq < key.seq)) {
+        now_queue.push_back({key, std::move(ev)});
+        return;
+    }
+    event_queue->push(key, std::move(ev));
 }
 
-void CSimpyEnv::run() {
-    while (!event_queue.empty()) {
+const EventKey& CSimpyEnv::next_key() const {
+    // The lane is sorted and due now; the heap may still hold an older entry for the same time.
+    if (!now_queue.empty()) {
+        if (event_queue->empty() || now_queue.front().key < event_queue->top().key) {
+            return now_queue.front().key;
+        }
+    }
+    return event_queue->top().key;
+}
+
+QueueEntry<EventPtr<SimEventBase>> CSimpyEnv::pop_next() {
+    const bool from_lane = !now_queue.empty() && (event_queue->empty() || now_queue.front().key < event_queue->top().key);
+    QueueEntry<EventPtr<SimEventBase>> entry = from_lane ? now_queue.pop_front() : event_queue->pop();
+    --entry.payload->queued;
+    discard_cancelled();
+    return entry;
+}
+
+void CSimpyEnv::discard_cancelled() {
+    while (tombstone_count > 0 && has_pending()) {
+        const bool from_lane = !now_queue.empty() && (event_queue->empty() || now_queue.front().key < event_queue->top().key);
+        SimEventBase& front = from_lane ? *now_queue.front().payload : *event_queue->top().payload;
+        if (!front.cancelled) return;
+        --front.queued;
+        --tombstone_count;
+        ++events_skipped;
+        if (from_lane) {
+            now_queue.pop_front();
+        } else {
+            event_queue->pop();
+        }
+    }
+}
+
+void CSimpyEnv::cancel(SimEventBase& ev) {
+    if (ev.cancelled || ev.queued == 0) return;
+    ev.cancelled = true;
+    ++events_cancelled;
+    tombstone_count += ev.queued;
+    discard_cancelled();
+    const size_t pending = now_queue.size() + event_queue->size();
+    if (static_cast<double>(tombstone_count) > compact_fraction * static_cast<double>(pending)) compact_queue();
+}
+
+void CSimpyEnv::compact_queue() {
+    auto is_tombstone = [](QueueEntry<EventPtr<SimEventBase>>& entry) {
+        if (!entry.payload->cancelled) return false;
+        --entry.payload->queued;
+        return true;
+    };
+    const size_t removed = now_queue.remove_if(is_tombstone) + event_queue->remove_if(is_tombstone);
+    tombstone_count -= removed;
+    events_skipped += removed;
+    ++queue_compactions;
+}
+
+void CSimpyEnv::schedule(std::shared_ptr<Task> t, const DebugLabel& label) {
+    schedule_resume(this->sim_time, t->process(), label);
+}
+
+ProcessHandle CSimpyEnv::add_process(std::shared_ptr<Task> task, std::shared_ptr<void> functor) {
+    uint32_t slot;
+    if (!free_process_slots.empty()) {
+        slot = free_process_slots.back();
+        free_process_slots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(processes.size());
+        processes.emplace_back();
+    }
+    ProcessSlot& entry = processes[slot];
+    entry.task = std::move(task);
+    entry.functor = std::move(functor);
+    entry.trace_id = ++process_id_gen;
+    return ProcessHandle{this, slot, entry.generation};
+}
+
+void CSimpyEnv::reap_finished(bool keep_frames) {
+    // Take the list first: destroying a frame can drop the last owner of other tasks.
+    std::vector<uint32_t> slots = std::move(finished_processes);
+    finished_processes.clear();
+    // Frames parked by an earlier reap belong to coroutines that have left their final suspend.
+    const size_t parked_before = parked_processes.size();
+    for (uint32_t slot : slots) {
+        ProcessSlot& entry = processes[slot];
+        ++entry.generation;  // outstanding handles and wake-ups stop resolving
+        auto task = std::move(entry.task);
+        auto functor = std::move(entry.functor);
+        free_process_slots.push_back(slot);
+        if (keep_frames) {
+            parked_processes.push_back(ProcessSlot{std::move(task), std::move(functor)});
+            continue;
+        }
+        task.reset();     // destroys the frame unless user code still holds the task
+        functor.reset();  // only after the frame that referenced it
+    }
+    for (size_t i = 0; i < parked_before; ++i) {
+        parked_processes[i].task.reset();
+        parked_processes[i].functor.reset();
+    }
+    parked_processes.erase(parked_processes.begin(), parked_processes.begin() + parked_before);
+}
+
+std::coroutine_handle<> CSimpyEnv::drain_now(bool finishing) {
+    // Queue dumps are printed per run-loop iteration, so debug builds always go back to it.
+    if constexpr (DEBUG_PRINT_QUEUE) return std::noop_coroutine();
+    // The reap run_loop does after each event. Plain events resumed below finish no processes.
+    if (!finished_processes.empty() || !parked_processes.empty()) reap_finished(finishing);
+    while (handoff_budget > 0 && due_now()) {
+        auto [key, ev] = pop_next();
+        --handoff_budget;
+        ++events_processed;
+        current_process = 0;
+        if (std::coroutine_handle<> next = ev->resume_target()) return next;
+        ev->resume();
+    }
+    current_process = 0;
+    return std::noop_coroutine();
+}
+
+size_t CSimpyEnv::run_loop(std::optional<int> horizon, size_t max_events, bool check_stop) {
+    size_t processed = 0;
+    while (processed < max_events && has_pending()) {
+        const int next_time = next_key().time;
+        if (horizon && next_time >= *horizon) break;
+        // The stop condition is only consulted between timestamps, never within one.
+        if (check_stop && stop_condition && next_time != sim_time && stop_condition()) break;
+
         print_event_queue_state();  // 🔍 Print before processing
 
-        std::shared_ptr<SimEventBase> ev = event_queue.top();
-        event_queue.pop();
+        auto [key, ev] = pop_next();
 
-        sim_time = ev->sim_time;
+        sim_time = key.time;
+        // Coroutines resumed here may process further events due now through handoff().
+        handoff_budget = max_events - processed - 1;
+        const uint64_t before = events_processed;
         ev->resume();  // resume the coroutine, which may enqueue again
+        handoff_budget = 0;
+        ++events_processed;
+        processed += events_processed - before;
+        if (!finished_processes.empty() || !parked_processes.empty()) reap_finished();
 
-        // No need to manually delete ev, shared_ptr manages lifetime
+        // Dropping ev returns pooled events to event_pool
     }
+    return processed;
 }
 
+void CSimpyEnv::run() {
+    run_loop(std::nullopt, std::numeric_limits<size_t>::max(), true);
+}
+
+void CSimpyEnv::run_until(int until) {
+    run_loop(until, std::numeric_limits<size_t>::max(), true);
+    // Only jump the clock when the horizon ended the run, not the stop condition.
+    if (sim_time < until && (!has_pending() || next_key().time >= until)) {
+        sim_time = until;
+    }
+}
 
+size_t CSimpyEnv::run_for(size_t n_events) {
+    return run_loop(std::nullopt, n_events, true);
+}
+
+bool CSimpyEnv::step() {
+    return run_loop(std::nullopt, 1, false) == 1;
+}
+
+std::optional<int> CSimpyEnv::peek_next_time() const {
+    if (!has_pending()) return std::nullopt;
+    return next_key().time;
+}
 
 void CSimpyEnv::print_event_queue_state() {
     if (!DEBUG_PRINT_QUEUE) return;
 
     std::cout << "🪄 Event Queue @ time " << sim_time << ":\n";
 
-    std::vector<std::shared_ptr<SimEventBase>> temp;
+    std::vector<QueueEntry<EventPtr<SimEventBase>>> temp;
 
     // Temporarily pop elements to inspect
-    while (!event_queue.empty()) {
-        std::shared_ptr<SimEventBase> e = event_queue.top();
-        event_queue.pop();
-        std::cout << "  - Scheduled at: " << e->sim_time;
-        if (auto ce = std::dynamic_pointer_cast<CoroutineProcess>(e)) {
+    while (has_pending()) {
+        auto entry = pop_next();
+        const auto& e = entry.payload;
+        std::cout << "  - Scheduled at: " << entry.key.time;
+        if (auto* ce = dynamic_cast<CoroutineProcess*>(e.get())) {
             std::cout << " [Coroutine: " << ce->label << "]";
         } else {
             std::cout << " (" << typeid(*e.get()).name() << ")";
         }
         std::cout << "\n";
-        temp.push_back(e);
+        temp.push_back(std::move(entry));
     }
 
-    // Restore the queue
-    for (const auto& e : temp) {
-        event_queue.push(e);
+    // Restore the queue (same-time entries go back through the fast lane in order)
+    for (auto& entry : temp) {
+        enqueue(entry.key, std::move(entry.payload));
     }
 }
 
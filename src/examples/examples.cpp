@@ -1,6 +1,7 @@
 #include "../../include/examples/simsettings.h"
 #include "../../include/examples/examples.h"
 #include "../../include/csimpy/csimpy_env.h"
+#include "../../include/csimpy/indexed_store.h"
 #include "../../include/examples/staffitem.h"
 #include "../../include/examples/EDstaff.h"
 
@@ -289,6 +290,59 @@ void example_8() {
     env.run();
 }
 
+/**
+ * Example: Demonstrates IndexedStore gets served from key indexes instead of filter scans.
+ * Staff are indexed by role (hash) and skill level (sorted); a request for a doctor waits until
+ * one is put back.
+ */
+void example_indexed_store() {
+    CSimpyEnv env;
+    IndexedStore staff(env, 10, "staff_pool");
+    auto by_role = staff.add_index([](const ItemBase& item) {
+        return IndexKey(static_cast<const StaffItem&>(item).role);
+    });
+    auto by_skill = staff.add_index([](const ItemBase& item) {
+        return IndexKey(static_cast<long long>(static_cast<const StaffItem&>(item).skill_level));
+    }, IndexKind::Sorted);
+
+    auto roster = env.create_task([&env, &staff]() -> Task {
+        StaffItem alice("Alice", 1, "Nurse", 2);
+        StaffItem bob("Bob", 2, "Doctor", 3);
+        StaffItem carol("Carol", 3, "Nurse", 3);
+        co_await staff.put(alice);
+        co_await staff.put(bob);
+        co_await staff.put(carol);
+        std::cout << "[" << env.sim_time << "] roster: 3 staff on shift\n";
+    });
+
+    auto ward = env.create_task([&env, &staff, by_role, by_skill]() -> Task {
+        co_await SimDelay(env, 1);
+        auto doctor = co_await staff.get_by(by_role, "Doctor");
+        std::cout << "[" << env.sim_time << "] ward: got " << doctor->to_string() << "\n";
+        auto senior = co_await staff.get_at_least(by_skill, 3);
+        std::cout << "[" << env.sim_time << "] ward: got senior " << senior->to_string() << "\n";
+        auto by_id = co_await staff.get_by(IndexedStore::by_id(), 1);
+        std::cout << "[" << env.sim_time << "] ward: got id 1 " << by_id->to_string() << "\n";
+
+        std::cout << "[" << env.sim_time << "] ward: waiting for another doctor\n";
+        auto next_doctor = co_await staff.get_by(by_role, "Doctor");
+        std::cout << "[" << env.sim_time << "] ward: got " << next_doctor->to_string() << "\n";
+        co_await staff.put(doctor);
+    });
+
+    auto handover = env.create_task([&env, &staff]() -> Task {
+        co_await SimDelay(env, 5);
+        StaffItem dave("Dave", 4, "Doctor", 2);
+        std::cout << "[" << env.sim_time << "] handover: Dave starts\n";
+        co_await staff.put(dave);
+    });
+
+    env.schedule(roster, "roster");
+    env.schedule(ward, "ward");
+    env.schedule(handover, "handover");
+    env.run();
+}
+
 /**
  * Example: Demonstrates Store usage with priority put/get.
  */
@@ -427,8 +481,7 @@ void example_gas_station() {
     };
 
     auto monitor = env.create_task([&env, &fuel_tank, &tank_truck]() -> Task {
-        const int MAX_TIME = 50; // or configurable
-        while (env.sim_time <= MAX_TIME) {
+        while (true) {
             co_await SimDelay(env, CHECK_INTERVAL);
             if (fuel_tank.level < LOW_THRESHOLD) {
                 std::cout << "[" << env.sim_time << "] Fuel low (level=" << fuel_tank.level
@@ -444,7 +497,8 @@ void example_gas_station() {
     }
     env.schedule(monitor, "fuel_monitor");
 
-    env.run();
+    const int MAX_TIME = 50; // or configurable
+    env.run_until(MAX_TIME);
 }
 
 /**
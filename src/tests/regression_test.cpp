@@ -2,8 +2,17 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 #include "../../include/csimpy/csimpy_env.h"
+#include "../../include/csimpy/replication.h"
+#include "../../include/csimpy/indexed_store.h"
+#include "../../include/csimpy/resource.h"
+#include "../../include/csimpy/typed_store.h"
+#include "../../include/examples/staffitem.h"
 #include "../../include//examples/examples.h"
 #include <sstream>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <set>
 #include <iostream>
 
 TEST_CASE("example_1 regression") {
@@ -180,6 +189,141 @@ TEST_CASE("example_8 regression") {
     CHECK_EQ(output, expected);
 }
 
+TEST_CASE("example_indexed_store regression") {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+
+    example_indexed_store();
+
+    std::cout.rdbuf(old);
+    std::string output = buffer.str();
+
+    const char* expected =
+        "[0] roster: 3 staff on shift\n"
+        "[1] ward: got StaffItem(Bob, id=2, role=Doctor, skill=3)\n"
+        "[1] ward: got senior StaffItem(Carol, id=3, role=Nurse, skill=3)\n"
+        "[1] ward: got id 1 StaffItem(Alice, id=1, role=Nurse, skill=2)\n"
+        "[1] ward: waiting for another doctor\n"
+        "[5] handover: Dave starts\n"
+        "[5] ward: got StaffItem(Dave, id=4, role=Doctor, skill=2)\n";
+
+    CHECK_EQ(output, expected);
+}
+
+TEST_CASE("IndexedStore keeps indexes consistent across puts and gets") {
+    CSimpyEnv env;
+    IndexedStore pool(env, 5000, "pool");
+    auto by_skill = pool.add_index([](const ItemBase& item) {
+        return IndexKey(static_cast<long long>(static_cast<const StaffItem&>(item).skill_level));
+    }, IndexKind::Sorted);
+    std::vector<int> taken;
+    auto proc = env.create_task([&]() -> Task {
+        for (int i = 0; i < 3000; ++i) {
+            co_await pool.put(std::make_shared<StaffItem>("s" + std::to_string(i), i, i % 2 ? "Nurse" : "Doctor", i % 5));
+        }
+        // Mix indexed, sorted and filter gets; each one must remove exactly the item it returns.
+        for (int i = 0; i < 3000; i += 7) {
+            auto item = co_await pool.get_by(IndexedStore::by_id(), i);
+            taken.push_back(item->id);
+        }
+        auto skilled = co_await pool.get_at_least(by_skill, 4);
+        taken.push_back(skilled->id);
+        auto named = co_await pool.get_by(IndexedStore::by_name(), "s10");
+        taken.push_back(named->id);
+        auto odd = co_await pool.get([](const std::shared_ptr<ItemBase>& item) { return item->id % 2 == 1; });
+        taken.push_back(odd->id);
+    });
+    env.schedule(proc, "proc");
+    env.run();
+
+    REQUIRE_EQ(taken.size(), 432u);
+    CHECK_EQ(taken[1], 7);
+    CHECK_EQ(taken[429], 4);   // oldest with skill >= 4; id 0 went to the first by-id get
+    CHECK_EQ(taken[430], 10);
+    CHECK_EQ(taken[431], 1);
+    CHECK_EQ(pool.size(), 3000u - 432u);
+    CHECK_EQ(pool.count_of(IndexedStore::by_id(), 7), 0u);
+    CHECK_EQ(pool.count_of(IndexedStore::by_id(), 8), 1u);
+    CHECK_EQ(pool.count_of(by_skill, 4), 600u - 86u - 1u);  // minus ids 7k and the one sorted get
+}
+
+TEST_CASE("AllOf/AnyOf results are indexed by child position") {
+    CSimpyEnv env;
+    auto a = std::make_shared<SimEvent>(env);
+    auto b = std::make_shared<SimEvent>(env);
+    auto c = std::make_shared<SimEvent>(env);
+    std::vector<std::string> all_names;
+    size_t any_winner = 99;
+    std::string any_name;
+
+    auto waiter = env.create_task([&]() -> Task {
+        auto allof = std::make_shared<AllOfEvent>(env, std::vector<std::shared_ptr<SimEvent>>{a, b, std::make_shared<SimDelay>(env, 1)});
+        auto results = co_await *allof;
+        for (const auto& r : results) all_names.push_back(r ? r->name : "-");
+    });
+    auto racer = env.create_task([&]() -> Task {
+        auto anyof = std::make_shared<AnyOfEvent>(env, std::vector<std::shared_ptr<SimEvent>>{std::make_shared<SimDelay>(env, 10), c});
+        auto results = co_await *anyof;
+        any_winner = anyof->winner;
+        any_name = results[anyof->winner]->name;
+    });
+    auto producer = env.create_task([&]() -> Task {
+        co_await SimDelay(env, 2);
+        // Both children carry the same item id; results must keep both.
+        a->set_value(std::make_shared<SimpleItem>("first", 7));
+        a->on_succeed();
+        b->set_value(std::make_shared<SimpleItem>("second", 7));
+        b->on_succeed();
+        c->set_value(std::make_shared<SimpleItem>("third", 7));
+        c->on_succeed();
+    });
+    env.schedule(waiter, "waiter");
+    env.schedule(racer, "racer");
+    env.schedule(producer, "producer");
+    env.run();
+
+    CHECK(all_names == std::vector<std::string>{"first", "second", "-"});
+    CHECK_EQ(any_winner, 1u);
+    CHECK_EQ(any_name, "third");
+}
+
+TEST_CASE("callback handles unsubscribe in O(1) without touching other subscribers") {
+    CSimpyEnv env;
+    std::vector<int> fired;
+    SimEvent shared(env);
+    auto first = shared.callbacks.add([&](int) { fired.push_back(1); });
+    auto second = shared.callbacks.add([&](int) { fired.push_back(2); });
+    shared.callbacks.add([&](int) { fired.push_back(3); });
+    second.cancel();
+    CHECK_FALSE(second.pending());
+    CHECK(first.pending());
+    shared.trigger();
+    CHECK(fired == std::vector<int>{1, 3});
+    CHECK_FALSE(first.pending());
+    first.cancel();  // already fired: no-op
+
+    // An AnyOf that loses interest in a shared event must leave the event's other waiters alone.
+    auto gate = std::make_shared<SimEvent>(env);
+    int direct_wakeup = -1;
+    auto racer = env.create_task([&]() -> Task {
+        auto anyof = std::make_shared<AnyOfEvent>(env, std::vector<std::shared_ptr<SimEvent>>{std::make_shared<SimDelay>(env, 1), gate});
+        co_await *anyof;
+    });
+    auto direct = env.create_task([&]() -> Task {
+        co_await *gate;
+        direct_wakeup = env.sim_time;
+    });
+    auto opener = env.create_task([&]() -> Task {
+        co_await SimDelay(env, 5);
+        gate->on_succeed();
+    });
+    env.schedule(racer, "racer");
+    env.schedule(direct, "direct");
+    env.schedule(opener, "opener");
+    env.run();
+    CHECK_EQ(direct_wakeup, 5);
+}
+
 TEST_CASE("example_carwash regression") {
     std::stringstream buffer;
     std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
@@ -219,4 +363,769 @@ TEST_CASE("example_carwash regression") {
         "[50] Car 8 leaves the carwash.\n";
 
     CHECK_EQ(output, expected);
-}
\ No newline at end of file
+}
+
+TEST_CASE("event pool reuses storage in steady state") {
+    CSimpyEnv env;
+    auto ticker = env.create_task([&env]() -> Task {
+        for (int i = 0; i < 10000; ++i) {
+            co_await SimDelay(env, 1);
+        }
+    });
+    env.schedule(ticker, "ticker");
+    env.run();
+
+    const auto& stats = env.event_pool.stats();
+    CHECK(stats.heap_allocations < 16);
+    CHECK(stats.reused >= 10000);
+    CHECK_EQ(stats.live, 0u);
+}
+
+TEST_CASE("coroutine frames are recycled through the env's frame pool") {
+    CSimpyEnv env;
+    int finished = 0;
+    auto patient = [&env, &finished](int stay) -> Task {
+        co_await SimDelay(env, stay);
+        ++finished;
+    };
+    env.schedule(env.create_task([&env, &patient]() -> Task {
+        for (int i = 0; i < 1000; ++i) {
+            env.schedule(env.create_task([&patient, i]() { return patient(1 + i % 3); }), "patient");
+            co_await SimDelay(env, 1);
+        }
+    }), "arrivals");
+    env.run();
+
+    const auto& stats = env.frame_pool.stats();
+    CHECK_EQ(finished, 1000);
+    CHECK_EQ(stats.allocations, 1001u);
+    CHECK(stats.reused >= 990);  // at most a handful of patients are in the system at once
+    CHECK(stats.heap_allocations <= 2);
+    CHECK_EQ(stats.live, 0u);
+}
+
+TEST_CASE("wake-ups carry no label outside debug builds") {
+    CHECK_EQ(std::is_empty_v<DebugLabel>, !DEBUG_PRINT_QUEUE);
+    if constexpr (!DEBUG_PRINT_QUEUE) {
+        CHECK_EQ(sizeof(CoroutineProcess), sizeof(SimEventBase) + sizeof(ProcessHandle));
+    }
+
+    CSimpyEnv env;
+    auto waiter = env.create_task([&env]() -> Task {
+        for (int i = 0; i < 1000; ++i) {
+            co_await SimDelay(env, 1, "labelled wait");
+        }
+    });
+    env.schedule(waiter, "waiter");
+    env.run();
+    CHECK_EQ(env.sim_time, 1000);
+    CHECK(env.event_pool.stats().heap_allocations < 16);
+}
+
+TEST_CASE("future event set backends pop in (time, seq) order") {
+    const QueueKind kinds[] = {QueueKind::QuadHeap, QueueKind::BinaryHeap, QueueKind::PairingHeap,
+                               QueueKind::CalendarQueue, QueueKind::TimingWheel};
+    std::vector<std::vector<size_t>> orders;
+    for (QueueKind kind : kinds) {
+        auto fes = make_future_event_set<int>(kind);
+        std::vector<size_t> order;
+        uint32_t rng = 12345;
+        auto next = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+        int now = 0;
+        size_t seq = 0;
+        // Interleave pushes (mostly small delays, some far-future, many ties) with pops.
+        for (int step = 0; step < 20000; ++step) {
+            if (fes->empty() || next() % 3 != 0) {
+                int delay = (next() % 10 == 0) ? static_cast<int>(next() % 100000) : static_cast<int>(next() % 8);
+                fes->push(EventKey{now + delay, seq++}, 0);
+            } else {
+                auto entry = fes->pop();
+                CHECK(entry.key.time >= now);
+                now = entry.key.time;
+                order.push_back(entry.key.seq);
+            }
+        }
+        while (!fes->empty()) order.push_back(fes->pop().key.seq);
+        orders.push_back(order);
+    }
+    for (size_t i = 1; i < orders.size(); ++i) {
+        CHECK(orders[i] == orders[0]);
+    }
+}
+
+TEST_CASE("CSimpyEnv output does not depend on the queue backend") {
+    auto run_model = [](QueueKind kind) {
+        CSimpyEnv env(kind);
+        Container machines(env, 3, "machines");
+        machines.set_level(3);
+        std::stringstream log;
+        auto customer = [&](int id, int service) {
+            return env.create_task([&env, &machines, &log, id, service]() -> Task {
+                log << env.sim_time << ":arrive " << id << "\n";
+                co_await machines.get(1);
+                log << env.sim_time << ":start " << id << "\n";
+                co_await SimDelay(env, service);
+                co_await machines.put(1);
+                log << env.sim_time << ":leave " << id << "\n";
+            });
+        };
+        auto source = env.create_task([&env, &customer]() -> Task {
+            uint32_t rng = 7;
+            for (int i = 0; i < 200; ++i) {
+                rng = rng * 1664525u + 1013904223u;
+                co_await SimDelay(env, static_cast<int>((rng >> 8) % 4));
+                env.schedule(customer(i, 1 + static_cast<int>((rng >> 16) % 9)), "customer");
+            }
+        });
+        env.schedule(source, "source");
+        env.run();
+        return log.str();
+    };
+    const std::string reference = run_model(QueueKind::QuadHeap);
+    CHECK_EQ(run_model(QueueKind::BinaryHeap), reference);
+    CHECK_EQ(run_model(QueueKind::PairingHeap), reference);
+    CHECK_EQ(run_model(QueueKind::CalendarQueue), reference);
+    CHECK_EQ(run_model(QueueKind::TimingWheel), reference);
+}
+
+TEST_CASE("run_until, run_for, step and stop_when bound execution") {
+    CSimpyEnv env;
+    std::vector<int> ticks;
+    auto ticker = env.create_task([&env, &ticks]() -> Task {
+        while (true) {
+            co_await SimDelay(env, 10);
+            ticks.push_back(env.sim_time);
+        }
+    });
+    env.schedule(ticker, "ticker");
+
+    CHECK_EQ(env.peek_next_time().value(), 0);
+    env.run_until(30);  // the tick due at 30 stays queued
+    CHECK_EQ(env.sim_time, 30);
+    CHECK(ticks == std::vector<int>{10, 20});
+    CHECK_EQ(env.peek_next_time().value(), 30);
+
+    // Each tick is two events: the delay firing, then the coroutine resuming.
+    CHECK(env.step());
+    CHECK(ticks == std::vector<int>{10, 20});
+    CHECK(env.step());
+    CHECK(ticks == std::vector<int>{10, 20, 30});
+    CHECK_EQ(env.run_for(4), 4u);
+    CHECK(ticks == std::vector<int>{10, 20, 30, 40, 50});
+
+    env.stop_when([&ticks]() { return ticks.size() >= 7; });
+    env.run();
+    CHECK(ticks == std::vector<int>{10, 20, 30, 40, 50, 60, 70});
+    CHECK_EQ(env.sim_time, 70);
+    CHECK_EQ(env.peek_next_time().value(), 80);
+
+    // A stop before the horizon leaves the clock where the run stopped.
+    env.run_until(200);
+    CHECK_EQ(env.sim_time, 70);
+    env.stop_when({});
+    env.run_until(200);
+    CHECK_EQ(env.sim_time, 200);
+    CHECK_EQ(ticks.back(), 190);
+}
+
+TEST_CASE("ReplicationRunner matches a serial run of the same seeds") {
+    // Single-server queue with random arrivals and service; returns the event log and total wait.
+    struct Outcome {
+        std::string log;
+        long total_wait = 0;
+    };
+    ReplicationRunner<Outcome>::Model model = [](CSimpyEnv& env, size_t) {
+        Outcome out;
+        Container server(env, 1, "server");
+        server.set_level(1);
+        auto customer = [&](int id) {
+            return env.create_task([&env, &server, &out, id]() -> Task {
+                const int arrived = env.sim_time;
+                co_await server.get(1);
+                out.total_wait += env.sim_time - arrived;
+                co_await SimDelay(env, 1 + static_cast<int>(env.rng() % 6));
+                co_await server.put(1);
+                out.log += std::to_string(env.sim_time) + ":" + std::to_string(id) + " ";
+            });
+        };
+        auto source = env.create_task([&env, &customer]() -> Task {
+            for (int i = 0; i < 50; ++i) {
+                co_await SimDelay(env, static_cast<int>(env.rng() % 5));
+                env.schedule(customer(i), "customer");
+            }
+        });
+        env.schedule(source, "source");
+        env.run();
+        return out;
+    };
+
+    ReplicationRunner<Outcome> serial(1);
+    ReplicationRunner<Outcome> parallel(4);
+    auto expected = serial.run(24, 2024, model);
+    auto actual = parallel.run(24, 2024, model);
+    REQUIRE_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        CHECK_EQ(actual[i].log, expected[i].log);
+        CHECK_EQ(actual[i].total_wait, expected[i].total_wait);
+    }
+    CHECK(expected[0].log != expected[1].log);  // each replication has its own stream
+
+    auto sum_waits = [](long acc, Outcome o) { return acc + o.total_wait; };
+    CHECK_EQ(parallel.run(24, 2024, model, 0L, sum_waits), serial.run(24, 2024, model, 0L, sum_waits));
+}
+
+TEST_CASE("finished processes are reclaimed and their handles go stale") {
+    CSimpyEnv env;
+    Container server(env, 2, "server");
+    server.set_level(2);
+    size_t served = 0;
+    size_t peak_slots = 0;
+    auto customer = [&]() {
+        return env.create_task([&env, &server, &served]() -> Task {
+            co_await server.get(1);
+            co_await SimDelay(env, 3);
+            co_await server.put(1);
+            ++served;
+        });
+    };
+    ProcessHandle first;
+    auto source = env.create_task([&]() -> Task {
+        for (int i = 0; i < 20000; ++i) {
+            auto c = customer();
+            if (i == 0) first = c->process();
+            env.schedule(c, "customer");
+            peak_slots = std::max(peak_slots, env.processes.size());
+            co_await SimDelay(env, 2);
+        }
+    });
+    env.schedule(source, "source");
+    env.run();
+
+    CHECK_EQ(served, 20000u);
+    CHECK(peak_slots < 16);  // slots are recycled, so the table stays at the concurrency level
+    CHECK_EQ(env.live_processes(), 0u);
+    CHECK_FALSE(first.alive());
+    CHECK(first.get() == nullptr);
+}
+
+namespace {
+Task timed_visit(CSimpyEnv& env, std::vector<std::string>& log, std::string who, int stay) {
+    try {
+        co_await SimDelay(env, stay);
+        log.push_back(std::to_string(env.sim_time) + ":" + who + " done");
+    } catch (const InterruptException&) {
+        log.push_back(std::to_string(env.sim_time) + ":" + who + " interrupted");
+    }
+}
+}
+
+TEST_CASE("env.process starts coroutines in place and returns usable handles") {
+    CSimpyEnv env;
+    std::vector<std::string> log;
+    ProcessHandle quick = env.process(timed_visit, env, log, "quick", 2);
+    ProcessHandle slow = env.process(timed_visit, env, log, "slow", 10);
+    auto holder_before = env.live_processes();
+
+    env.process([&env, &log, quick, slow]() -> Task {
+        auto quick_done = quick.completion();
+        co_await *quick_done;
+        log.push_back(std::to_string(env.sim_time) + ":saw quick finish");
+        slow.interrupt();
+        auto slow_done = slow.completion();
+        co_await *slow_done;
+        log.push_back(std::to_string(env.sim_time) + ":saw slow finish");
+        // Handles to finished processes stay safe: the completion is already done.
+        co_await SimDelay(env, 1);
+        CHECK_FALSE(quick.alive());
+        auto stale_done = quick.completion();
+        CHECK(stale_done->done);
+        co_await *stale_done;
+        log.push_back(std::to_string(env.sim_time) + ":stale handle ok");
+    });
+    env.run();
+
+    CHECK_EQ(holder_before, 2u);
+    const std::vector<std::string> expected = {"2:quick done", "2:saw quick finish", "2:slow interrupted",
+                                               "2:saw slow finish", "3:stale handle ok"};
+    CHECK(log == expected);
+    CHECK_EQ(env.live_processes(), 0u);
+}
+
+namespace {
+// Joins, zero delays and a container handoff, all at a handful of timestamps, so most wake-ups
+// are due at the current time and can be handed off directly.
+std::vector<std::string> handoff_model(CSimpyEnv& env, bool stepwise) {
+    std::vector<std::string> log;
+    Container tokens(env, 1, "tokens");
+    auto child = [&env, &log](int id) -> Task {
+        co_await SimDelay(env, 0);
+        log.push_back(std::to_string(env.sim_time) + ":child " + std::to_string(id));
+    };
+    for (int p = 0; p < 3; ++p) {
+        env.process([&env, &log, &tokens, &child, p]() -> Task {
+            for (int i = 0; i < 3; ++i) {
+                auto done = env.process(child, p * 10 + i).completion();
+                co_await *done;
+                log.push_back(std::to_string(env.sim_time) + ":parent " + std::to_string(p));
+                auto put = tokens.put(1);
+                co_await *put;
+                auto get = tokens.get(1);
+                co_await *get;
+                co_await SimDelay(env, p);
+            }
+        });
+    }
+    if (stepwise) {
+        while (env.step()) {}
+    } else {
+        env.run();
+    }
+    log.push_back("end " + std::to_string(env.sim_time) + " events " + std::to_string(env.events_processed));
+    return log;
+}
+}
+
+TEST_CASE("direct handoffs between coroutines keep run()'s event order") {
+    // step() processes exactly one event and never hands off, so it is the reference order.
+    CSimpyEnv direct;
+    CSimpyEnv stepped;
+    const auto a = handoff_model(direct, false);
+    const auto b = handoff_model(stepped, true);
+    CHECK(a == b);
+    CHECK_EQ(a.size(), 19u);
+    CHECK_EQ(direct.live_processes(), 0u);
+}
+
+TEST_CASE("immediate_requests serves satisfiable requests without queueing") {
+    auto model = [](bool immediate, std::vector<std::string>& log) {
+        CSimpyEnv env;
+        env.immediate_requests = immediate;
+        Container bays(env, 2, "bays");
+        bays.set_level(2);
+        Store parts(env, 10, "parts");
+        std::vector<bool> served_at_once;
+        auto car = [&](int id) -> Task {
+            auto bay = bays.get(1);
+            served_at_once.push_back(bay->immediate);
+            co_await *bay;
+            auto part = parts.put(std::make_shared<SimpleItem>("part", id));
+            co_await *part;
+            log.push_back(std::to_string(env.sim_time) + ":car " + std::to_string(id) + " in");
+            co_await SimDelay(env, 5);
+            auto own = parts.get([id](const std::shared_ptr<ItemBase>& item) { return item->id == id; });
+            auto taken = co_await *own;
+            log.push_back(std::to_string(env.sim_time) + ":car " + std::to_string(id) + " took " + taken->to_string());
+            auto release = bays.put(1);
+            co_await *release;
+        };
+        for (int i = 0; i < 3; ++i) env.process(car, i);
+        env.run();
+        CHECK_EQ(bays.level, 2);
+        CHECK_EQ(parts.items.size(), 0u);
+        const std::vector<bool> expected = {immediate, immediate, false};
+        CHECK(served_at_once == expected);
+        return env.events_processed;
+    };
+    std::vector<std::string> queued_log, immediate_log;
+    const uint64_t queued_events = model(false, queued_log);
+    const uint64_t immediate_events = model(true, immediate_log);
+    // Here no two processes compete within a timestamp, so only the event count differs.
+    CHECK(immediate_log == queued_log);
+    CHECK(immediate_events < queued_events);
+}
+
+TEST_CASE("cancelled events are skipped and compacted out of the queue") {
+    for (QueueKind kind : {QueueKind::QuadHeap, QueueKind::BinaryHeap, QueueKind::PairingHeap,
+                           QueueKind::CalendarQueue, QueueKind::TimingWheel}) {
+        CSimpyEnv env(kind);
+        int wakeups = 0;
+        int interrupts = 0;
+        // A sleeper interrupted every tick: each interrupt strands the copy of its long delay.
+        auto sleeper = env.process([&env, &wakeups, &interrupts]() -> Task {
+            for (;;) {
+                try {
+                    co_await SimDelay(env, 1000);
+                    ++wakeups;
+                    co_return;
+                } catch (const InterruptException&) {
+                    ++interrupts;
+                }
+            }
+        });
+        env.process([&env, sleeper]() -> Task {
+            for (int i = 0; i < 100; ++i) {
+                co_await SimDelay(env, 1);
+                sleeper.interrupt();
+            }
+        });
+        // The loser of an AnyOf is withdrawn once nothing else waits for it.
+        std::string anyof_result;
+        env.process([&env, &anyof_result]() -> Task {
+            auto fast = std::make_shared<SimDelay>(env, 5);
+            auto slow = std::make_shared<SimDelay>(env, 5000);
+            auto race = std::make_shared<AnyOfEvent>(env, std::initializer_list<std::shared_ptr<SimEvent>>{fast, slow});
+            co_await *race;
+            anyof_result = "winner " + std::to_string(race->winner) + " at " + std::to_string(env.sim_time);
+        });
+
+        env.run_until(50);  // the interrupt due at 50 is still queued
+        CHECK_EQ(interrupts, 49);
+        CHECK_EQ(anyof_result, "winner 0 at 5");
+        // Two live entries remain (the sleeper's delay and the interrupter's); tombstones are
+        // compacted away before they outnumber them, instead of the 49 stale delays piling up.
+        CHECK(env.tombstones() <= 2);
+        CHECK(env.queue_compactions > 0);
+
+        env.run();
+        CHECK_EQ(interrupts, 100);
+        CHECK_EQ(wakeups, 1);
+        CHECK_EQ(env.events_cancelled, 101u);
+        CHECK_EQ(env.events_skipped, 101u);
+        CHECK_EQ(env.tombstones(), 0u);
+        // The last live event is the sleeper's final wake-up; the stale delays did not stretch the run.
+        CHECK_EQ(env.sim_time, 1100);
+    }
+}
+
+TEST_CASE("blocked Container and Store requests renege on timeout or interrupt") {
+    CSimpyEnv env;
+    Container beds(env, 1, "beds", WaiterDiscipline::Fifo);
+    beds.set_level(1);
+    std::stringstream log;
+    auto patient = [&env, &beds, &log](std::string who, int patience, int stay) -> Task {
+        try {
+            auto bed = beds.get_with_timeout(1, patience);
+            if (co_await bed == 0) {
+                log << env.sim_time << ":" << who << " left ";
+                co_return;
+            }
+            log << env.sim_time << ":" << who << " bed ";
+            co_await SimDelay(env, stay);
+            co_await beds.put(1);
+        } catch (const InterruptException&) {
+            log << env.sim_time << ":" << who << " interrupted ";
+        }
+    };
+    env.process(patient, "a", 100, 8);
+    env.process(patient, "b", 5, 1);           // head of the queue, gives up at 5
+    auto c = env.process(patient, "c", 100, 1); // called away at 3
+    env.process([&env, &patient, c]() -> Task {
+        co_await SimDelay(env, 1);
+        env.process(patient, "d", 20, 2);       // served at 8; its timer must not outlive it
+        co_await SimDelay(env, 2);
+        c.interrupt();
+    });
+    env.run();
+    // Neither the reneging nor the interrupted patient takes a bed for a coroutine that is gone,
+    // and with them withdrawn FIFO order lets d through as soon as a leaves.
+    CHECK_EQ(log.str(), "0:a bed 3:c interrupted 5:b left 8:d bed ");
+    CHECK_EQ(beds.get_level(), 1);
+    CHECK(beds.get_waiters.empty());
+    CHECK_EQ(env.sim_time, 10);
+
+    // Store: a timed-out get yields nullptr, and the item put later is left for the next getter.
+    Store shelf(env, 1, "shelf");
+    std::shared_ptr<ItemBase> first, second;
+    env.process([&env, &shelf, &first]() -> Task {
+        auto item = shelf.get_with_timeout(4);
+        first = co_await item;
+        CHECK(item->timed_out);
+    });
+    env.process([&env, &shelf, &second]() -> Task {
+        co_await SimDelay(env, 6);
+        co_await shelf.put(std::make_shared<SimpleItem>("box", 1));
+        auto item = shelf.get_with_timeout(4, Priority::High);
+        second = co_await item;
+        CHECK_FALSE(item->timed_out);
+    });
+    env.run();
+    CHECK(first == nullptr);
+    CHECK(second != nullptr);
+    CHECK(shelf.get_waiters.empty());
+    CHECK_EQ(env.sim_time, 16);
+}
+
+TEST_CASE("Resource tokens, priority service and preemption") {
+    CSimpyEnv env;
+    std::stringstream log;
+
+    // Two bays, three cars: the third waits for the first token to be released.
+    Resource bays(env, 2, "bays");
+    auto car = [&env, &bays, &log](std::string who, int wash) -> Task {
+        ResourceToken bay = co_await bays.request();
+        log << env.sim_time << ":" << who << " in ";
+        co_await SimDelay(env, wash);
+    };
+    env.process(car, "a", 3);
+    env.process(car, "b", 5);
+    env.process(car, "c", 1);
+    env.run_until(1);
+    CHECK_EQ(bays.count(), 2);
+    CHECK_EQ(bays.queue_length(), 1u);
+    env.run();
+    CHECK_EQ(log.str(), "0:a in 0:b in 3:c in ");
+    CHECK_EQ(bays.count(), 0);
+
+    // Waiters are served highest priority first, FIFO within a priority.
+    log.str("");
+    PriorityResource bed(env, 1, "bed");
+    auto patient = [&env, &bed, &log](std::string who, int priority) -> Task {
+        auto token = co_await bed.request(Priority{priority});
+        log << env.sim_time << ":" << who << " ";
+        co_await SimDelay(env, 2);
+        token.release();
+        CHECK_FALSE(token.held());
+    };
+    env.process(patient, "first", 0);
+    env.process(patient, "low", 0);
+    env.process(patient, "urgent", 5);
+    env.process(patient, "high", 1);
+    env.run();
+    CHECK_EQ(log.str(), "5:first 7:urgent 9:high 11:low ");
+
+    // A more urgent request interrupts the lowest-priority holder and takes its unit.
+    log.str("");
+    PreemptiveResource doctor(env, 1, "doctor");
+    auto visit = [&env, &doctor, &log](std::string who, int priority, int length) -> Task {
+        ResourceToken token;
+        for (;;) {
+            token = co_await doctor.request(Priority{priority});
+            try {
+                co_await SimDelay(env, length);
+                break;
+            } catch (const InterruptException& e) {
+                auto preempted = std::dynamic_pointer_cast<Preempted>(e.cause);
+                REQUIRE(preempted);
+                CHECK_FALSE(token.held());
+                log << env.sim_time << ":" << who << " preempted (since " << preempted->usage_since << ") ";
+            }
+        }
+        log << env.sim_time << ":" << who << " done ";
+    };
+    env.process(visit, "routine", 0, 10);
+    env.process([&env, &visit]() -> Task {
+        co_await SimDelay(env, 2);
+        env.process(visit, "trauma", 3, 4);
+    });
+    env.run();
+    // The routine visit restarts once the trauma releases the doctor.
+    CHECK_EQ(log.str(), "15:routine preempted (since 13) 19:trauma done 29:routine done ");
+    CHECK_EQ(doctor.count(), 0);
+}
+
+TEST_CASE("Container level watchers wake only when their threshold is crossed") {
+    CSimpyEnv env;
+    Container tank(env, 100, "tank");
+    tank.set_level(50);
+    std::stringstream log;
+    auto below = [&env, &tank, &log](int threshold) -> Task {
+        const int seen = co_await tank.when_level_below(threshold);
+        log << env.sim_time << ":below " << threshold << " at " << seen << " ";
+    };
+    auto at_least = [&env, &tank, &log](int threshold) -> Task {
+        try {
+            const int seen = co_await tank.when_level_at_least(threshold);
+            log << env.sim_time << ":at_least " << threshold << " at " << seen << " ";
+        } catch (const InterruptException&) {
+            log << env.sim_time << ":at_least " << threshold << " withdrawn ";
+        }
+    };
+    env.process(below, 30);
+    env.process(below, 10);
+    env.process(at_least, 60);
+    env.process(at_least, 90);
+    env.process(at_least, 40);  // already met
+    auto never = env.process(at_least, 100);
+    env.process([&env, &tank, never]() -> Task {
+        for (int i = 0; i < 5; ++i) {
+            co_await SimDelay(env, 1);
+            co_await tank.get(10);
+        }
+        co_await SimDelay(env, 1);
+        co_await tank.put(70);
+        never.interrupt();
+        co_await SimDelay(env, 1);
+        tank.set_level(95);
+    });
+    env.run();
+    CHECK_EQ(log.str(), "0:at_least 40 at 50 3:below 30 at 20 5:below 10 at 0 6:at_least 60 at 70 "
+                        "6:at_least 100 withdrawn 7:at_least 90 at 95 ");
+    CHECK_EQ(env.sim_time, 7);
+}
+
+TEST_CASE("Store serves integer priorities highest first and FIFO within a level") {
+    CSimpyEnv env;
+    Store store(env, 100, "triage");
+    std::vector<int> served;
+    auto patient = [&](int id, int level) {
+        return env.create_task([&env, &store, &served, id, level]() -> Task {
+            auto item = co_await store.get({}, Priority{level});
+            served.push_back(id);
+        });
+    };
+    // 30 patients over 5 triage levels arrive before any item is available.
+    for (int id = 0; id < 30; ++id) {
+        env.schedule(patient(id, id % 5), "patient");
+    }
+    auto staff = env.create_task([&env, &store]() -> Task {
+        co_await SimDelay(env, 1);
+        for (int i = 0; i < 30; ++i) {
+            co_await store.put(std::make_shared<SimpleItem>("bed", i));
+        }
+    });
+    env.schedule(staff, "staff");
+    env.run();
+
+    std::vector<int> expected;
+    for (int level = 4; level >= 0; --level) {
+        for (int id = level; id < 30; id += 5) expected.push_back(id);
+    }
+    CHECK(served == expected);
+}
+
+TEST_CASE("Store::get accepts inline predicates alongside shared_ptr filters") {
+    CSimpyEnv env;
+    Store store(env, 10, "staff");
+    std::vector<int> got;
+    auto id_is = [](int id) {
+        return [id](const std::shared_ptr<ItemBase>& item) { return item->id == id; };
+    };
+    auto worker = env.create_task([&]() -> Task {
+        for (int i = 0; i < 4; ++i) co_await store.put(std::make_shared<SimpleItem>("staff", i));
+        // Served immediately: no getter is waiting.
+        auto a = co_await store.get(id_is(2));
+        got.push_back(a->id);
+        auto b = co_await store.get(std::make_shared<std::function<bool(const std::shared_ptr<ItemBase>&)>>(id_is(0)));
+        got.push_back(b->id);
+    });
+    // Waits until item 7 arrives; the predicate (with a large capture) is kept in the event.
+    auto waiter = env.create_task([&]() -> Task {
+        std::array<int, 32> padding{};
+        padding[0] = 7;
+        auto c = co_await store.get([padding](const std::shared_ptr<ItemBase>& item) { return item->id == padding[0]; });
+        got.push_back(c->id);
+    });
+    auto late = env.create_task([&]() -> Task {
+        co_await SimDelay(env, 5);
+        co_await store.put(std::make_shared<SimpleItem>("staff", 7));
+    });
+    env.schedule(worker, "worker");
+    env.schedule(waiter, "waiter");
+    env.schedule(late, "late");
+    env.run();
+
+    CHECK(got == std::vector<int>{2, 0, 7});
+    CHECK_EQ(store.items.size(), 2u);
+}
+
+TEST_CASE("TypedStore moves values through in FIFO order and honours capacity and filters") {
+    struct Job {
+        int id = 0;
+        std::string tag;
+    };
+    CSimpyEnv env;
+    TypedStore<Job> jobs(env, 2, "jobs");
+    std::vector<std::string> log;
+    auto producer = env.create_task([&env, &jobs, &log]() -> Task {
+        for (int i = 0; i < 5; ++i) {
+            Job job{i, i % 2 ? "odd" : "even"};
+            co_await jobs.put(std::move(job));
+            log.push_back(std::to_string(env.sim_time) + ":put" + std::to_string(i));
+        }
+    });
+    auto consumer = env.create_task([&env, &jobs, &log]() -> Task {
+        co_await SimDelay(env, 1);
+        Job first = co_await jobs.get();
+        log.push_back(std::to_string(env.sim_time) + ":get" + std::to_string(first.id));
+        Job odd = co_await jobs.get([](const Job& j) { return j.tag == "odd"; });
+        log.push_back(std::to_string(env.sim_time) + ":get" + std::to_string(odd.id));
+        for (int i = 0; i < 3; ++i) {
+            Job job = co_await jobs.get();
+            log.push_back(std::to_string(env.sim_time) + ":get" + std::to_string(job.id));
+        }
+    });
+    env.schedule(producer, "producer");
+    env.schedule(consumer, "consumer");
+    env.run();
+
+    // The store holds two jobs, so the third put waits for the first get.
+    const std::vector<std::string> expected = {"0:put0", "0:put1", "1:get0", "1:put2", "1:get1",
+                                               "1:put3", "1:get2", "1:put4", "1:get3", "1:get4"};
+    CHECK(log == expected);
+    CHECK_EQ(jobs.size(), 0u);
+}
+
+TEST_CASE("Container waiter discipline: first-fit vs head-of-line FIFO") {
+    auto run_model = [](WaiterDiscipline discipline) {
+        CSimpyEnv env;
+        Container tank(env, 100, "tank", discipline);
+        std::stringstream log;
+        auto getter = [&](const char* who, int amount) {
+            return env.create_task([&env, &tank, &log, who, amount]() -> Task {
+                co_await tank.get(amount);
+                log << env.sim_time << ":" << who << " ";
+            });
+        };
+        env.schedule(getter("big", 50), "big");
+        env.schedule(getter("small", 10), "small");
+        auto filler = env.create_task([&env, &tank]() -> Task {
+            co_await SimDelay(env, 1);
+            co_await tank.put(20);
+            co_await SimDelay(env, 1);
+            co_await tank.put(40);
+        });
+        env.schedule(filler, "filler");
+        env.run();
+        return log.str();
+    };
+    // First-fit lets the small request overtake the blocked big one; FIFO keeps arrival order.
+    CHECK_EQ(run_model(WaiterDiscipline::FirstFit), "1:small 2:big ");
+    CHECK_EQ(run_model(WaiterDiscipline::Fifo), "2:big 2:small ");
+}
+
+TEST_CASE("binary trace records every schedule, request and completion") {
+    const std::string path = (std::filesystem::temp_directory_path() / "csimpy_trace_test.bin").string();
+    uint64_t emitted = 0;
+    {
+        CSimpyEnv env;
+        env.enable_trace(path, 64);  // small ring, so the writer thread has to keep up
+        Container machines(env, 2, "machines");
+        machines.set_level(2);
+        for (int i = 0; i < 50; ++i) {
+            env.schedule(env.create_task([&env, &machines]() -> Task {
+                co_await machines.get(1);
+                co_await SimDelay(env, 3);
+                co_await machines.put(1);
+            }), "customer");
+        }
+        env.run();
+        emitted = env.trace_records();
+        env.disable_trace();
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    TraceFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    REQUIRE(in.good());
+    CHECK_EQ(std::string(header.magic), "CSTRACE");
+    std::map<TraceKind, int> counts;
+    std::set<uint32_t> processes;
+    TraceRecord r;
+    uint64_t read = 0;
+    while (in.read(reinterpret_cast<char*>(&r), sizeof(r))) {
+        ++read;
+        ++counts[static_cast<TraceKind>(r.kind)];
+        if (static_cast<TraceKind>(r.kind) == TraceKind::ContainerGet) {
+            CHECK_EQ(r.resource, 1u);
+            processes.insert(r.process);
+        }
+    }
+    std::filesystem::remove(path);
+
+    CHECK_EQ(read, emitted);
+    CHECK_EQ(counts[TraceKind::ContainerGet], 50);
+    CHECK_EQ(counts[TraceKind::ContainerPut], 50);
+    CHECK_EQ(counts[TraceKind::TaskDone], 50);
+    CHECK_EQ(processes.size(), 50u);  // each request is attributed to the process that made it
+    CHECK(counts[TraceKind::Resume] >= 150);
+}
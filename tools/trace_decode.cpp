@@ -0,0 +1,57 @@
+// Decodes a binary trace written by CSimpyEnv::enable_trace.
+//
+// Usage: csimpy_trace_decode <trace file> [--summary]
+// Prints one CSV row per record, or with --summary the number of records of each kind.
+
+#include "../include/csimpy/trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <trace file> [--summary]\n", argv[0]);
+        return 2;
+    }
+    const bool summary = argc > 2 && std::strcmp(argv[2], "--summary") == 0;
+
+    std::FILE* file = std::fopen(argv[1], "rb");
+    if (!file) {
+        std::fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    TraceFileHeader header;
+    const TraceFileHeader expected;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        std::fprintf(stderr, "%s is not a csimpy trace\n", argv[1]);
+        return 1;
+    }
+    if (header.version != expected.version || header.record_size != sizeof(TraceRecord)) {
+        std::fprintf(stderr, "unsupported trace version %u (record size %u)\n", header.version, header.record_size);
+        return 1;
+    }
+
+    unsigned long long counts[256] = {};
+    TraceRecord records[4096];
+    if (!summary) std::printf("sim_time,seq,kind,process,resource\n");
+    size_t n;
+    while ((n = std::fread(records, sizeof(TraceRecord), 4096, file)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const TraceRecord& r = records[i];
+            ++counts[r.kind];
+            if (!summary) {
+                std::printf("%d,%llu,%s,%u,%u\n", r.sim_time, static_cast<unsigned long long>(r.seq),
+                            to_string(static_cast<TraceKind>(r.kind)), r.process, r.resource);
+            }
+        }
+    }
+    std::fclose(file);
+
+    if (summary) {
+        for (int k = 0; k < 256; ++k) {
+            if (counts[k]) std::printf("%s,%llu\n", to_string(static_cast<TraceKind>(k)), counts[k]);
+        }
+    }
+    return 0;
+}